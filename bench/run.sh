@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+# Runs every bench/*.axp on both engines and reports the median and p95 wall
+# time and the peak resident memory of each. Results are printed and written
+# to bench_output.txt, one line per benchmark and engine, so the files of two
+# commits can be compared with diff.
+#
+# Usage: bench/run.sh [binary]    RUNS=N sets the runs per benchmark (default 5)
+
+set -u
+cd "$(dirname "$0")/.."
+
+binary=${1:-bin/axscript}
+runs=${RUNS:-5}
+output=bench_output.txt
+stats=$(mktemp)
+trap 'rm -f "$stats"' EXIT
+
+# Nearest-rank percentile of the sorted numbers on stdin
+percentile() {
+    sort -n | awk -v p="$1" '{ v[NR] = $1 } END { i = int((p * NR + 99) / 100); print v[i < 1 ? 1 : i] }'
+}
+
+{
+    echo "# commit $(git rev-parse --short HEAD 2>/dev/null || echo unknown), $runs runs each"
+    printf '%-10s %-7s %10s %10s %12s\n' benchmark engine median_ms p95_ms peak_rss_kb
+} > "$output"
+cat "$output"
+
+for script in bench/*.axp; do
+    name=$(basename "$script" .axp)
+    for engine in vm interp; do
+        flag=--no-cache
+        [ "$engine" = interp ] && flag=--interp
+
+        times=()
+        peak=0
+        failed=0
+        for ((i = 0; i < runs; i++)); do
+            start=$EPOCHREALTIME
+            "$binary" "$flag" --stats=json "$script" > /dev/null 2> "$stats" || failed=1
+            end=$EPOCHREALTIME
+            grep -q '^{' "$stats" && ! grep -qi 'error' "$stats" || failed=1
+
+            times+=("$(awk -v s="$start" -v e="$end" 'BEGIN { printf "%.1f", (e - s) * 1000 }')")
+            rss=$(grep -o '"peak_rss_bytes": [0-9]*' "$stats" | grep -o '[0-9]*$')
+            rss=$(( ${rss:-0} / 1024 ))
+            (( rss > peak )) && peak=$rss
+        done
+
+        if (( failed )); then
+            printf '%-10s %-7s %10s %10s %12s\n' "$name" "$engine" FAILED - - | tee -a "$output"
+            continue
+        fi
+        median=$(printf '%s\n' "${times[@]}" | percentile 50)
+        p95=$(printf '%s\n' "${times[@]}" | percentile 95)
+        printf '%-10s %-7s %10s %10s %12s\n' "$name" "$engine" "$median" "$p95" "$peak" | tee -a "$output"
+    done
+done
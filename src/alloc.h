@@ -0,0 +1,76 @@
+// alloc.h
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <cstddef>
+#include <new>
+
+// Allocator for heap objects. Most objects are small and short lived, so
+// instead of going to malloc each time they are bump-allocated out of large
+// blocks, grouped by size, and freed objects are reused by the next
+// allocation of the same size. Blocks are never returned to the system.
+class ObjAllocator
+{
+public:
+    static void* allocate(size_t size) {
+        size_t sizeClass = classOf(size);
+        if (sizeClass >= kClassCount || !kPooled) {
+            return ::operator new(size);
+        }
+
+        FreeObject*& freeList = freeLists[sizeClass];
+        if (freeList != nullptr) {
+            FreeObject* object = freeList;
+            freeList = object->next;
+            return object;
+        }
+
+        size_t rounded = (sizeClass + 1) * kGranularity;
+        if (static_cast<size_t>(limit - cursor) < rounded) {
+            cursor = static_cast<char*>(::operator new(kBlockSize));
+            limit = cursor + kBlockSize;
+        }
+        void* object = cursor;
+        cursor += rounded;
+        return object;
+    }
+
+    static void deallocate(void* pointer, size_t size) {
+        size_t sizeClass = classOf(size);
+        if (sizeClass >= kClassCount || !kPooled) {
+            ::operator delete(pointer);
+            return;
+        }
+
+        FreeObject* object = static_cast<FreeObject*>(pointer);
+        object->next = freeLists[sizeClass];
+        freeLists[sizeClass] = object;
+    }
+
+private:
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    static constexpr size_t kGranularity = 16;
+    static constexpr size_t kClassCount = 16;  // Objects up to 256 bytes
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    // Under AddressSanitizer every object gets its own allocation, so use
+    // after free is still caught
+#if defined(__SANITIZE_ADDRESS__)
+    static constexpr bool kPooled = false;
+#else
+    static constexpr bool kPooled = true;
+#endif
+
+    static inline FreeObject* freeLists[kClassCount] = {};
+    static inline char* cursor = nullptr;
+    static inline char* limit = nullptr;
+
+    static size_t classOf(size_t size) {
+        return (size + kGranularity - 1) / kGranularity - 1;
+    }
+};
+
+#endif // ALLOC_H
@@ -1,9 +1,14 @@
 #ifndef AST_H
 #define AST_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <vector>
 #include <string>
+#include "intern.h"
 #include "tokens.h"
 #include "visitor.h"
 
@@ -12,21 +17,109 @@ class FunctionStmt;
 class CallExpr;
 class ReturnStmt;
 
-class Expr
+// Base of every AST node. Nodes are owned by the AstArena that created them,
+// which chains them together so it can run their destructors.
+class AstNode
+{
+public:
+    virtual ~AstNode() = default;
+
+private:
+    friend class AstArena;
+    AstNode* nextInArena = nullptr;
+};
+
+// Links between nodes keep unique_ptr's move-only handling, but the arena
+// frees the nodes, so the deleter does nothing.
+struct AstNodeDeleter
+{
+    void operator()(const AstNode*) const {}
+};
+
+template <typename T>
+using AstPtr = std::unique_ptr<T, AstNodeDeleter>;
+
+class Expr;
+class Stmt;
+using ExprPtr = AstPtr<Expr>;
+using StmtPtr = AstPtr<Stmt>;
+
+// Bump allocator for the nodes of one parse. Nodes are placed back to back in
+// large blocks and the whole tree is released when the arena is destroyed.
+class AstArena
+{
+public:
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    ~AstArena()
+    {
+        AstNode* node = nodes;
+        while (node != nullptr)
+        {
+            AstNode* next = node->nextInArena;
+            node->~AstNode();
+            node = next;
+        }
+    }
+
+    template <typename T, typename... Args>
+    AstPtr<T> make(Args&&... args)
+    {
+        T* node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        AstNode* base = node;
+        base->nextInArena = nodes;
+        nodes = base;
+        count++;
+        return AstPtr<T>(node);
+    }
+
+    // Nodes created so far
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    uintptr_t cursor = 0;
+    uintptr_t limit = 0;
+    AstNode* nodes = nullptr; // Most recently created first
+    size_t count = 0;
+
+    void* allocate(size_t size, size_t align)
+    {
+        uintptr_t start = (cursor + align - 1) & ~(uintptr_t(align) - 1);
+        if (blocks.empty() || start + size > limit)
+        {
+            size_t blockSize = std::max(kBlockSize, size + align);
+            blocks.emplace_back(new char[blockSize]);
+            cursor = reinterpret_cast<uintptr_t>(blocks.back().get());
+            limit = cursor + blockSize;
+            start = (cursor + align - 1) & ~(uintptr_t(align) - 1);
+        }
+        cursor = start + size;
+        return reinterpret_cast<void*>(start);
+    }
+};
+
+class Expr : public AstNode
 {
 public:
-    virtual ~Expr() = default;
     virtual void accept(Visitor *visitor) = 0;
 };
 
 class BinaryExpr : public Expr
 {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
+    ExprPtr left;
+    ExprPtr right;
     Token op;
 
-    BinaryExpr(std::unique_ptr<Expr> left, Token op, std::unique_ptr<Expr> right)
+    BinaryExpr(ExprPtr left, Token op, ExprPtr right)
         : left(std::move(left)), op(op), right(std::move(right)) {}
 
     void accept(Visitor *visitor) override
@@ -39,8 +132,15 @@ class NumberExpr : public Expr
 {
 public:
     double value;
+    int64_t integerValue = 0;   // The exact value when 'integer'
+    bool integer = false;       // evaluates to an integer rather than a double
+
+    explicit NumberExpr(double value) : value(value) {}
+    explicit NumberExpr(int64_t value) : value(static_cast<double>(value)), integerValue(value), integer(true) {}
 
-    NumberExpr(double value) : value(value) {}
+    Value literal() const {
+        return integer ? makeInteger(integerValue) : makeNumber(value);
+    }
 
     void accept(Visitor *visitor) override
     {
@@ -64,9 +164,9 @@ public:
 class StringExpr : public Expr
 {
 public:
-    std::string value;
+    ObjString* value;  // Interned
 
-    StringExpr(const std::string &value) : value(value) {}
+    StringExpr(ObjString* value) : value(value) {}
 
     void accept(Visitor *visitor) override
     {
@@ -78,6 +178,8 @@ class VariableExpr : public Expr
 {
 public:
     Token name;
+    int depth = 0;   // Function scopes to walk out, filled in by the Resolver
+    int slot = -1;   // Slot in that scope's environment
 
     VariableExpr(Token name) : name(name) {}
 
@@ -90,9 +192,11 @@ public:
 class AssignExpr : public Expr {
 public:
     Token name;
-    std::unique_ptr<Expr> value;
+    ExprPtr value;
+    int depth = 0;   // Function scopes to walk out, filled in by the Resolver
+    int slot = -1;   // Slot in that scope's environment
 
-    AssignExpr(Token name, std::unique_ptr<Expr> value)
+    AssignExpr(Token name, ExprPtr value)
         : name(name), value(std::move(value)) {}
 
     void accept(Visitor* visitor) override {
@@ -102,10 +206,10 @@ public:
 
 class CompEqExpr : public Expr {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
+    ExprPtr left;
+    ExprPtr right;
 
-    CompEqExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right)
+    CompEqExpr(ExprPtr left, ExprPtr right)
         : left(std::move(left)), right(std::move(right)) {}
 
     void accept(Visitor* visitor) override {
@@ -115,9 +219,9 @@ public:
 
 class ArrayExpr : public Expr {
 public:
-    std::vector<std::unique_ptr<Expr>> elements;
+    std::vector<ExprPtr> elements;
 
-    ArrayExpr(std::vector<std::unique_ptr<Expr>>&& elements) 
+    ArrayExpr(std::vector<ExprPtr>&& elements) 
         : elements(std::move(elements)) {}
 
     void accept(Visitor* visitor) override {
@@ -125,12 +229,26 @@ public:
     }
 };
 
+// {key: value, ...}; keys[i] goes with values[i]
+class MapExpr : public Expr {
+public:
+    std::vector<ExprPtr> keys;
+    std::vector<ExprPtr> values;
+
+    MapExpr(std::vector<ExprPtr>&& keys, std::vector<ExprPtr>&& values)
+        : keys(std::move(keys)), values(std::move(values)) {}
+
+    void accept(Visitor* visitor) override {
+        visitor->visit(this);
+    }
+};
+
 class FixedArrayExpr : public Expr {
 public:
     int size;
-    std::vector<std::unique_ptr<Expr>> elements;
+    std::vector<ExprPtr> elements;
 
-    FixedArrayExpr(int size, std::vector<std::unique_ptr<Expr>>&& elements) 
+    FixedArrayExpr(int size, std::vector<ExprPtr>&& elements) 
         : size(size), elements(std::move(elements)) {}
 
     void accept(Visitor* visitor) override {
@@ -140,10 +258,10 @@ public:
 
 class IndexExpr : public Expr {
 public:
-    std::unique_ptr<Expr> object;
-    std::unique_ptr<Expr> index;
+    ExprPtr object;
+    ExprPtr index;
 
-    IndexExpr(std::unique_ptr<Expr> object, std::unique_ptr<Expr> index)
+    IndexExpr(ExprPtr object, ExprPtr index)
         : object(std::move(object)), index(std::move(index)) {}
 
     void accept(Visitor* visitor) override {
@@ -153,11 +271,11 @@ public:
 
 class AssignIndexExpr : public Expr {
 public:
-    std::unique_ptr<Expr> object;
-    std::unique_ptr<Expr> index;
-    std::unique_ptr<Expr> value;
+    ExprPtr object;
+    ExprPtr index;
+    ExprPtr value;
 
-    AssignIndexExpr(std::unique_ptr<Expr> object, std::unique_ptr<Expr> index, std::unique_ptr<Expr> value)
+    AssignIndexExpr(ExprPtr object, ExprPtr index, ExprPtr value)
         : object(std::move(object)), index(std::move(index)), value(std::move(value)) {}
 
     void accept(Visitor* visitor) override {
@@ -167,13 +285,13 @@ public:
 
 class CallExpr : public Expr {
 public:
-    std::unique_ptr<Expr> callee;
+    ExprPtr callee;
     Token paren;  // Closing parenthesis for error reporting
-    std::vector<std::unique_ptr<Expr>> arguments;
+    std::vector<ExprPtr> arguments;
 
-    CallExpr(std::unique_ptr<Expr> callee, 
+    CallExpr(ExprPtr callee, 
              Token paren,
-             std::vector<std::unique_ptr<Expr>> arguments)
+             std::vector<ExprPtr> arguments)
         : callee(std::move(callee)), 
           paren(paren), 
           arguments(std::move(arguments)) {}
@@ -183,18 +301,19 @@ public:
     }
 };
 
-class Stmt
+class Stmt : public AstNode
 {
 public:
-    virtual ~Stmt() = default;
+    int line = 0;  // Where the statement starts, filled in by the Parser; 0 if unknown
+
     virtual void accept(Visitor *visitor) = 0;
 };
 
 class PrintStmt : public Stmt
 {
 public:
-    std::unique_ptr<Expr> expression;
-    PrintStmt(std::unique_ptr<Expr> expression) : expression(std::move(expression)) {};
+    ExprPtr expression;
+    PrintStmt(ExprPtr expression) : expression(std::move(expression)) {};
 
     void accept(Visitor *visitor) override
     {
@@ -206,9 +325,10 @@ class VarStmt : public Stmt
 {
 public:
     Token name;
-    std::unique_ptr<Expr> initializer;
+    ExprPtr initializer;
+    int slot = -1;   // Slot in the current scope, filled in by the Resolver
 
-    VarStmt(Token name, std::unique_ptr<Expr> initializer) : name(name), initializer(std::move(initializer)) {}
+    VarStmt(Token name, ExprPtr initializer) : name(name), initializer(std::move(initializer)) {}
 
     void accept(Visitor *visitor) override
     {
@@ -220,6 +340,7 @@ class InputStmt : public Stmt
 {
 public:
     Token variableName;
+    int slot = -1;   // Slot in the current scope, filled in by the Resolver
     InputStmt(Token variablename) : variableName(variablename) {}
     void accept(Visitor *visitor) override
     {
@@ -229,9 +350,9 @@ public:
 
 class BlockStmt : public Stmt {
 public:
-    std::vector<std::unique_ptr<Stmt>> statements;
+    std::vector<StmtPtr> statements;
     
-    BlockStmt(std::vector<std::unique_ptr<Stmt>>&& stmts) 
+    BlockStmt(std::vector<StmtPtr>&& stmts) 
         : statements(std::move(stmts)) {}
         
     void accept(Visitor* visitor) override {
@@ -242,14 +363,16 @@ public:
 class LoopStmt : public Stmt {
 public:
     Token var;
-    std::unique_ptr<Expr> from;
-    std::unique_ptr<Expr> to;
-    std::unique_ptr<Expr> step;  // Optional step value
-    std::unique_ptr<Stmt> body;
+    ExprPtr from;
+    ExprPtr to;
+    ExprPtr step;  // Optional step value
+    StmtPtr body;
     bool isDownward;  // Indicates if it's counting down
+    int slot = -1;    // Slot of the loop variable, filled in by the Resolver
+    bool varUsed = true;  // False when nothing ever reads or assigns the loop variable
 
-    LoopStmt(Token var, std::unique_ptr<Expr> from, std::unique_ptr<Expr> to, 
-             std::unique_ptr<Expr> step, std::unique_ptr<Stmt> body, bool isDownward)
+    LoopStmt(Token var, ExprPtr from, ExprPtr to, 
+             ExprPtr step, StmtPtr body, bool isDownward)
         : var(var), from(std::move(from)), to(std::move(to)), 
           step(std::move(step)), body(std::move(body)), isDownward(isDownward) {}
 
@@ -277,9 +400,9 @@ public:
 class ExpressionStmt : public Stmt
 {
 public:
-    std::unique_ptr<Expr> expression;
+    ExprPtr expression;
 
-    ExpressionStmt(std::unique_ptr<Expr> expression) : expression(std::move(expression)) {}
+    ExpressionStmt(ExprPtr expression) : expression(std::move(expression)) {}
 
     void accept(Visitor *visitor) override
     {
@@ -287,128 +410,29 @@ public:
     }
 };
 
-class CompEqStmt : public Stmt {
-public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
-
-    CompEqStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-               std::unique_ptr<Stmt> thenBranch, std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
-
-    void accept(Visitor *visitor) override {
-        visitor->visit(this);
-    }
-};
-
-class CompNeqStmt : public Stmt {
-public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
-
-    CompNeqStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-                std::unique_ptr<Stmt> thenBranch,
-                std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-                std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)),
-          elseIfBranches(std::move(elseIfBranches)),
-          elseBranch(std::move(elseBranch)) {}
-
-    void accept(Visitor *visitor) override {
-        visitor->visit(this);
-    }
-};
-
-class CompGeStmt : public Stmt {
-public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
-
-    CompGeStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-               std::unique_ptr<Stmt> thenBranch,
-               std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-               std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)),
-          elseIfBranches(std::move(elseIfBranches)),
-          elseBranch(std::move(elseBranch)) {}
-
-    void accept(Visitor *visitor) override {
-        visitor->visit(this);
-    }
-};
-
-class CompLeStmt : public Stmt {
+// compeq, compneq, compge, comple, compg and compl with their 'else if'
+// arms. The arms are tested in order and the first whose comparison holds
+// runs; if none does, elseBranch runs.
+class CompareStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
+    struct Arm {
+        TokenType op;  // The operator the keyword stands for: EQUAL_EQUAL for compeq, GREATER for compg, ...
+        ExprPtr left;
+        ExprPtr right;
+        StmtPtr body;
+    };
 
-    CompLeStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-               std::unique_ptr<Stmt> thenBranch,
-               std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-               std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)),
-          elseIfBranches(std::move(elseIfBranches)),
-          elseBranch(std::move(elseBranch)) {}
-
-    void accept(Visitor *visitor) override {
-        visitor->visit(this);
-    }
-};
+    std::vector<Arm> arms;
+    StmtPtr elseBranch;
 
-class CompGStmt : public Stmt {
-public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
+    // Chains that compare one variable against literals pick their arm from
+    // a table instead (see dispatch.h). The Interpreter builds it the first
+    // time the statement runs.
+    bool dispatchChecked = false;
+    Value dispatch;
 
-    CompGStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-              std::unique_ptr<Stmt> thenBranch,
-              std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-              std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)),
-          elseIfBranches(std::move(elseIfBranches)),
-          elseBranch(std::move(elseBranch)) {}
-
-    void accept(Visitor *visitor) override {
-        visitor->visit(this);
-    }
-};
-
-class CompLStmt : public Stmt {
-public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
-
-    CompLStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, 
-              std::unique_ptr<Stmt> thenBranch,
-              std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-              std::unique_ptr<Stmt> elseBranch = nullptr)
-        : left(std::move(left)), right(std::move(right)), 
-          thenBranch(std::move(thenBranch)),
-          elseIfBranches(std::move(elseIfBranches)),
-          elseBranch(std::move(elseBranch)) {}
+    CompareStmt(std::vector<Arm> arms, StmtPtr elseBranch = nullptr)
+        : arms(std::move(arms)), elseBranch(std::move(elseBranch)) {}
 
     void accept(Visitor *visitor) override {
         visitor->visit(this);
@@ -417,15 +441,15 @@ public:
 
 class AndStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::unique_ptr<Stmt> elseBranch;
+    ExprPtr left;
+    ExprPtr right;
+    StmtPtr thenBranch;
+    StmtPtr elseBranch;
 
     // Constructor for direct AND conditions
-    AndStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right,
-            std::unique_ptr<Stmt> thenBranch,
-            std::unique_ptr<Stmt> elseBranch = nullptr)
+    AndStmt(ExprPtr left, ExprPtr right,
+            StmtPtr thenBranch,
+            StmtPtr elseBranch = nullptr)
         : left(std::move(left)), right(std::move(right)),
           thenBranch(std::move(thenBranch)),
           elseBranch(std::move(elseBranch)) {}
@@ -437,15 +461,15 @@ public:
 
 class OrStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::unique_ptr<Stmt> thenBranch;
-    std::unique_ptr<Stmt> elseBranch;
+    ExprPtr left;
+    ExprPtr right;
+    StmtPtr thenBranch;
+    StmtPtr elseBranch;
 
     // Constructor for direct OR conditions
-    OrStmt(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right,
-           std::unique_ptr<Stmt> thenBranch,
-           std::unique_ptr<Stmt> elseBranch = nullptr)
+    OrStmt(ExprPtr left, ExprPtr right,
+           StmtPtr thenBranch,
+           StmtPtr elseBranch = nullptr)
         : left(std::move(left)), right(std::move(right)),
           thenBranch(std::move(thenBranch)),
           elseBranch(std::move(elseBranch)) {}
@@ -457,14 +481,14 @@ public:
 
 class NotStmt : public Stmt {
 public:
-    std::unique_ptr<Expr> operand;
-    std::unique_ptr<Stmt> thenBranch;
-    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-    std::unique_ptr<Stmt> elseBranch;
+    ExprPtr operand;
+    StmtPtr thenBranch;
+    std::vector<std::pair<ExprPtr, StmtPtr>> elseIfBranches;
+    StmtPtr elseBranch;
 
-    NotStmt(std::unique_ptr<Expr> operand, std::unique_ptr<Stmt> thenBranch,
-            std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches = {},
-            std::unique_ptr<Stmt> elseBranch = nullptr)
+    NotStmt(ExprPtr operand, StmtPtr thenBranch,
+            std::vector<std::pair<ExprPtr, StmtPtr>> elseIfBranches = {},
+            StmtPtr elseBranch = nullptr)
         : operand(std::move(operand)), thenBranch(std::move(thenBranch)),
           elseIfBranches(std::move(elseIfBranches)),
           elseBranch(std::move(elseBranch)) {}
@@ -476,13 +500,13 @@ public:
 
 class ConditionStmt : public Stmt {
 public:
-    std::vector<std::unique_ptr<Stmt>> conditions;
-    std::unique_ptr<Stmt> thenBranch;
-    std::unique_ptr<Stmt> elseBranch;
+    std::vector<StmtPtr> conditions;
+    StmtPtr thenBranch;
+    StmtPtr elseBranch;
 
-    ConditionStmt(std::vector<std::unique_ptr<Stmt>>&& conditions, 
-                  std::unique_ptr<Stmt> thenBranch,
-                  std::unique_ptr<Stmt> elseBranch = nullptr)
+    ConditionStmt(std::vector<StmtPtr>&& conditions, 
+                  StmtPtr thenBranch,
+                  StmtPtr elseBranch = nullptr)
         : conditions(std::move(conditions)), 
           thenBranch(std::move(thenBranch)),
           elseBranch(std::move(elseBranch)) {}
@@ -492,9 +516,9 @@ public:
 
 class AndConditionStmt : public ConditionStmt {
 public:
-    AndConditionStmt(std::vector<std::unique_ptr<Stmt>>&& conditions, 
-                     std::unique_ptr<Stmt> thenBranch,
-                     std::unique_ptr<Stmt> elseBranch = nullptr)
+    AndConditionStmt(std::vector<StmtPtr>&& conditions, 
+                     StmtPtr thenBranch,
+                     StmtPtr elseBranch = nullptr)
         : ConditionStmt(std::move(conditions), std::move(thenBranch), std::move(elseBranch)) {}
     
     void accept(Visitor* visitor) override {
@@ -504,9 +528,9 @@ public:
 
 class OrConditionStmt : public ConditionStmt {
 public:
-    OrConditionStmt(std::vector<std::unique_ptr<Stmt>>&& conditions, 
-                    std::unique_ptr<Stmt> thenBranch,
-                    std::unique_ptr<Stmt> elseBranch = nullptr)
+    OrConditionStmt(std::vector<StmtPtr>&& conditions, 
+                    StmtPtr thenBranch,
+                    StmtPtr elseBranch = nullptr)
         : ConditionStmt(std::move(conditions), std::move(thenBranch), std::move(elseBranch)) {}
     
     void accept(Visitor* visitor) override {
@@ -518,11 +542,13 @@ class FunctionStmt : public Stmt {
 public:
     Token name;
     std::vector<Token> parameters;
-    std::vector<std::unique_ptr<Stmt>> body;
+    std::vector<StmtPtr> body;
+    int slot = -1;                        // Slot of the function name in the enclosing scope
+    std::vector<std::string> localNames;  // Names of the body's slots; parameters come first
 
     FunctionStmt(Token name, 
                 std::vector<Token> parameters, 
-                std::vector<std::unique_ptr<Stmt>> body)
+                std::vector<StmtPtr> body)
         : name(name), parameters(std::move(parameters)), body(std::move(body)) {}
 
     void accept(Visitor* visitor) override {
@@ -533,9 +559,9 @@ public:
 class ReturnStmt : public Stmt {
 public:
     Token keyword;
-    std::unique_ptr<Expr> value;
+    ExprPtr value;
 
-    ReturnStmt(Token keyword, std::unique_ptr<Expr> value = nullptr)
+    ReturnStmt(Token keyword, ExprPtr value = nullptr)
         : keyword(keyword), value(std::move(value)) {}
 
     void accept(Visitor* visitor) override {
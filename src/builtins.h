@@ -0,0 +1,534 @@
+// builtins.h
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "environment.h"
+#include "kernels.h"
+#include "runtime.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A function implemented in C++. Natives never need an Environment: the VM
+// passes them a pointer to the arguments on its stack, and the interpreter an
+// array on its own stack, so a call allocates nothing beyond its result.
+class NativeFunction : public Callable {
+public:
+    using Implementation = Value (*)(const Value* arguments);
+
+    // Lets the interpreter keep the arguments of a native call in a fixed array
+    static const int kMaxArity = 3;
+
+    NativeFunction(std::string name, int arity, Implementation implementation)
+        : Callable(Kind::NATIVE), name(std::move(name)), parameterCount(arity), implementation(implementation) {}
+
+    int arity() const override {
+        return parameterCount;
+    }
+
+    // 'arguments' holds arity() values, already checked by the caller
+    Value invoke(const Value* arguments) const {
+        Stats::nativeCalls++;
+        return implementation(arguments);
+    }
+
+    Value call(Interpreter* interpreter, const std::vector<Value>& arguments) override {
+        Stats::nativeCalls++;
+        return implementation(arguments.data());
+    }
+
+    std::string toString() const override {
+        return "<native function " + name + ">";
+    }
+
+private:
+    std::string name;
+    int parameterCount;
+    Implementation implementation;
+};
+
+// Argument checks shared by the builtins; 'function' names the builtin in errors
+
+inline double numberArgument(const Value& value, const char* function) {
+    if (!isNumber(value)) {
+        throw std::runtime_error(std::string(function) + "() expects a number.");
+    }
+    return value.number();
+}
+
+inline const std::string& stringArgument(const Value& value, const char* function) {
+    if (!isString(value)) {
+        throw std::runtime_error(std::string(function) + "() expects a string.");
+    }
+    return asString(value);
+}
+
+inline ObjArray& arrayArgument(const Value& value, const char* function) {
+    if (!isArray(value)) {
+        throw std::runtime_error(std::string(function) + "() expects an array.");
+    }
+    return asArray(value);
+}
+
+// A position within a sequence of 'size' elements, clamped to [0, size]
+inline size_t positionArgument(const Value& value, size_t size, const char* function) {
+    double position = numberArgument(value, function);
+    if (!(position > 0)) {
+        return 0;
+    }
+    return position >= static_cast<double>(size) ? size : static_cast<size_t>(position);
+}
+
+// A run of numbers read from an array argument
+struct NumberSpan {
+    const double* data;
+    size_t size;
+    bool integers;  // Every element is an integer
+};
+
+// The numbers of an array argument: its packed storage, or a copy in
+// 'scratch' if the array is generic but holds only numbers
+inline NumberSpan numbersArgument(const Value& value, const char* function, std::vector<double>& scratch) {
+    if (isArray(value)) {
+        const ObjArray& array = asArray(value);
+        if (array.isPacked()) {
+            return {array.numberData(), array.size(), array.empty() || array.packsIntegers()};
+        }
+        scratch.clear();
+        scratch.reserve(array.size());
+        bool integers = true;
+        for (size_t i = 0; i < array.size(); i++) {
+            Value element = array.get(i);
+            if (!isNumber(element)) {
+                break;
+            }
+            integers = integers && element.isInteger();
+            scratch.push_back(element.number());
+        }
+        if (scratch.size() == array.size()) {
+            return {scratch.data(), scratch.size(), integers};
+        }
+    }
+    throw std::runtime_error(std::string(function) + "() expects an array of numbers.");
+}
+
+inline void checkSameLength(NumberSpan a, NumberSpan b, const char* function) {
+    if (a.size != b.size) {
+        throw std::runtime_error(std::string(function) + "() expects arrays of the same length.");
+    }
+}
+
+// Integer arguments give the same exact results as the operators, so they
+// go through the elements one at a time instead of the double kernels.
+// Sums and products that leave 64 bits fall back to doubles, like + and *.
+
+// False if the sum leaves 64 bits
+inline bool integerSum(const ObjArray& array, int64_t& total) {
+    total = 0;
+    if (array.isPacked()) {
+        // Packed integers are at most 2^53 either way, so no block of 512
+        // can overflow and only the block totals need checking
+        const size_t kBlock = 512;
+        const double* data = array.numberData();
+        for (size_t start = 0; start < array.size(); start += kBlock) {
+            size_t end = std::min(array.size(), start + kBlock);
+            int64_t block = 0;
+            for (size_t i = start; i < end; i++) {
+                block += static_cast<int64_t>(data[i]);
+            }
+            if (__builtin_add_overflow(total, block, &total)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    for (size_t i = 0; i < array.size(); i++) {
+        if (__builtin_add_overflow(total, array.get(i).integer(), &total)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// False if a product or the sum leaves 64 bits
+inline bool integerDot(const ObjArray& a, const ObjArray& b, int64_t& total) {
+    total = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t product;
+        if (__builtin_mul_overflow(a.get(i).integer(), b.get(i).integer(), &product) ||
+            __builtin_add_overflow(total, product, &total)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The smallest, or largest, element of a non-empty array of integers
+inline Value integerExtreme(const ObjArray& array, bool largest) {
+    int64_t extreme = array.get(0).integer();
+    for (size_t i = 1; i < array.size(); i++) {
+        int64_t element = array.get(i).integer();
+        extreme = largest ? std::max(extreme, element) : std::min(extreme, element);
+    }
+    return makeInteger(extreme);
+}
+
+// Applies an operator to each pair of elements; makeArray packs the
+// results again when they allow it
+inline Value combineElements(const ObjArray& a, const ObjArray& b, Value (*operation)(const Value&, const Value&)) {
+    std::vector<Value> result;
+    result.reserve(a.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        result.push_back(operation(a.get(i), b.get(i)));
+    }
+    return makeArray(std::move(result));
+}
+
+// Arrays of numbers, see ArrayKernels
+
+inline Value builtinSum(const Value* arguments) {
+    std::vector<double> scratch;
+    NumberSpan values = numbersArgument(arguments[0], "sum", scratch);
+    int64_t total;
+    if (values.integers && integerSum(asArray(arguments[0]), total)) {
+        return makeInteger(total);
+    }
+    return makeNumber(ArrayKernels::sum(values.data, values.size));
+}
+
+inline Value builtinMin(const Value* arguments) {
+    std::vector<double> scratch;
+    NumberSpan values = numbersArgument(arguments[0], "min", scratch);
+    if (values.size == 0) {
+        throw std::runtime_error("min() of an empty array.");
+    }
+    if (values.integers) {
+        return integerExtreme(asArray(arguments[0]), false);
+    }
+    return makeNumber(ArrayKernels::min(values.data, values.size));
+}
+
+inline Value builtinMax(const Value* arguments) {
+    std::vector<double> scratch;
+    NumberSpan values = numbersArgument(arguments[0], "max", scratch);
+    if (values.size == 0) {
+        throw std::runtime_error("max() of an empty array.");
+    }
+    if (values.integers) {
+        return integerExtreme(asArray(arguments[0]), true);
+    }
+    return makeNumber(ArrayKernels::max(values.data, values.size));
+}
+
+inline Value builtinDot(const Value* arguments) {
+    std::vector<double> scratchA, scratchB;
+    NumberSpan a = numbersArgument(arguments[0], "dot", scratchA);
+    NumberSpan b = numbersArgument(arguments[1], "dot", scratchB);
+    checkSameLength(a, b, "dot");
+    int64_t total;
+    if (a.integers && b.integers && integerDot(asArray(arguments[0]), asArray(arguments[1]), total)) {
+        return makeInteger(total);
+    }
+    return makeNumber(ArrayKernels::dot(a.data, b.data, a.size));
+}
+
+inline Value builtinScale(const Value* arguments) {
+    std::vector<double> scratch;
+    NumberSpan values = numbersArgument(arguments[0], "scale", scratch);
+    double factor = numberArgument(arguments[1], "scale");
+    if (values.integers && arguments[1].isInteger()) {
+        const ObjArray& array = asArray(arguments[0]);
+        std::vector<Value> result;
+        result.reserve(array.size());
+        for (size_t i = 0; i < array.size(); i++) {
+            result.push_back(multiplyNumbers(array.get(i), arguments[1]));
+        }
+        return makeArray(std::move(result));
+    }
+    std::vector<double> result(values.size);
+    ArrayKernels::scale(values.data, factor, result.data(), values.size);
+    return makeArray(std::move(result));
+}
+
+inline Value builtinAdd(const Value* arguments) {
+    std::vector<double> scratchA, scratchB;
+    NumberSpan a = numbersArgument(arguments[0], "add", scratchA);
+    NumberSpan b = numbersArgument(arguments[1], "add", scratchB);
+    checkSameLength(a, b, "add");
+    if (a.integers && b.integers) {
+        return combineElements(asArray(arguments[0]), asArray(arguments[1]), addNumbers);
+    }
+    std::vector<double> result(a.size);
+    ArrayKernels::add(a.data, b.data, result.data(), a.size);
+    return makeArray(std::move(result));
+}
+
+inline Value builtinMul(const Value* arguments) {
+    std::vector<double> scratchA, scratchB;
+    NumberSpan a = numbersArgument(arguments[0], "mul", scratchA);
+    NumberSpan b = numbersArgument(arguments[1], "mul", scratchB);
+    checkSameLength(a, b, "mul");
+    if (a.integers && b.integers) {
+        return combineElements(asArray(arguments[0]), asArray(arguments[1]), multiplyNumbers);
+    }
+    std::vector<double> result(a.size);
+    ArrayKernels::mul(a.data, b.data, result.data(), a.size);
+    return makeArray(std::move(result));
+}
+
+// Arrays and strings
+
+inline Value builtinLen(const Value* arguments) {
+    if (isArray(arguments[0])) {
+        return makeInteger(static_cast<int64_t>(asArray(arguments[0]).size()));
+    }
+    if (isString(arguments[0])) {
+        return makeInteger(static_cast<int64_t>(asString(arguments[0]).size()));
+    }
+    if (isMap(arguments[0])) {
+        return makeInteger(static_cast<int64_t>(asMap(arguments[0]).size()));
+    }
+    throw std::runtime_error("len() expects an array, a string or a map.");
+}
+
+// Appends in place and returns the new length
+inline Value builtinPush(const Value* arguments) {
+    ObjArray& array = arrayArgument(arguments[0], "push");
+    array.append(arguments[1]);
+    return makeInteger(static_cast<int64_t>(array.size()));
+}
+
+inline Value builtinPop(const Value* arguments) {
+    ObjArray& array = arrayArgument(arguments[0], "pop");
+    if (array.empty()) {
+        throw std::runtime_error("pop() of an empty array.");
+    }
+    return array.removeLast();
+}
+
+// Elements from start up to, not including, end; both are clamped to the bounds
+inline Value builtinSlice(const Value* arguments) {
+    if (isString(arguments[0])) {
+        const std::string& text = asString(arguments[0]);
+        size_t start = positionArgument(arguments[1], text.size(), "slice");
+        size_t end = positionArgument(arguments[2], text.size(), "slice");
+        return makeString(start < end ? text.substr(start, end - start) : std::string());
+    }
+
+    const ObjArray& array = arrayArgument(arguments[0], "slice");
+    size_t start = positionArgument(arguments[1], array.size(), "slice");
+    size_t end = std::max(start, positionArgument(arguments[2], array.size(), "slice"));
+    if (array.isPacked()) {
+        return makeArray(std::vector<double>(array.numberData() + start, array.numberData() + end), array.packsIntegers());
+    }
+    std::vector<Value> elements;
+    elements.reserve(end - start);
+    for (size_t i = start; i < end; i++) {
+        elements.push_back(array.get(i));
+    }
+    return makeArray(std::move(elements));
+}
+
+// Index of the first occurrence, or -1
+inline Value builtinFind(const Value* arguments) {
+    const std::string& text = stringArgument(arguments[0], "find");
+    size_t position = text.find(stringArgument(arguments[1], "find"));
+    return makeInteger(position == std::string::npos ? -1 : static_cast<int64_t>(position));
+}
+
+// An empty separator splits into single characters
+inline Value builtinSplit(const Value* arguments) {
+    const std::string& text = stringArgument(arguments[0], "split");
+    const std::string& separator = stringArgument(arguments[1], "split");
+    std::vector<Value> parts;
+    if (separator.empty()) {
+        for (char c : text) {
+            parts.push_back(makeString(std::string(1, c)));
+        }
+        return makeArray(std::move(parts));
+    }
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find(separator, start);
+        if (end == std::string::npos) {
+            parts.push_back(makeString(text.substr(start)));
+            break;
+        }
+        parts.push_back(makeString(text.substr(start, end - start)));
+        start = end + separator.size();
+    }
+    return makeArray(std::move(parts));
+}
+
+inline Value builtinJoin(const Value* arguments) {
+    const ObjArray& array = arrayArgument(arguments[0], "join");
+    const std::string& separator = stringArgument(arguments[1], "join");
+    std::string result;
+    for (size_t i = 0; i < array.size(); i++) {
+        if (i > 0) {
+            result += separator;
+        }
+        result += valueToString(array.get(i));
+    }
+    return makeString(result);
+}
+
+// Maps
+
+inline ObjMap& mapArgument(const Value& value, const char* function) {
+    if (!isMap(value)) {
+        throw std::runtime_error(std::string(function) + "() expects a map.");
+    }
+    return asMap(value);
+}
+
+// Keys in the order they were first added
+inline Value builtinKeys(const Value* arguments) {
+    std::vector<Value> keys;
+    for (const auto& entry : mapArgument(arguments[0], "keys").entries()) {
+        if (!entry.key.isUndefined()) {
+            keys.push_back(entry.key);
+        }
+    }
+    return makeArray(std::move(keys));
+}
+
+inline Value builtinValues(const Value* arguments) {
+    std::vector<Value> values;
+    for (const auto& entry : mapArgument(arguments[0], "values").entries()) {
+        if (!entry.key.isUndefined()) {
+            values.push_back(entry.value);
+        }
+    }
+    return makeArray(std::move(values));
+}
+
+inline Value builtinHas(const Value* arguments) {
+    return makeBoolean(mapArgument(arguments[0], "has").find(arguments[1]) != nullptr);
+}
+
+// Returns whether the key was present
+inline Value builtinRemove(const Value* arguments) {
+    return makeBoolean(mapArgument(arguments[0], "remove").remove(arguments[1]));
+}
+
+// Math
+
+inline Value builtinAbs(const Value* arguments) {
+    return makeNumber(std::fabs(numberArgument(arguments[0], "abs")));
+}
+
+inline Value builtinSqrt(const Value* arguments) {
+    return makeNumber(std::sqrt(numberArgument(arguments[0], "sqrt")));
+}
+
+inline Value builtinPow(const Value* arguments) {
+    return makeNumber(std::pow(numberArgument(arguments[0], "pow"), numberArgument(arguments[1], "pow")));
+}
+
+inline Value builtinFloor(const Value* arguments) {
+    return makeNumberOrInteger(std::floor(numberArgument(arguments[0], "floor")));
+}
+
+inline Value builtinCeil(const Value* arguments) {
+    return makeNumberOrInteger(std::ceil(numberArgument(arguments[0], "ceil")));
+}
+
+inline Value builtinRound(const Value* arguments) {
+    return makeNumberOrInteger(std::round(numberArgument(arguments[0], "round")));
+}
+
+inline Value builtinSin(const Value* arguments) {
+    return makeNumber(std::sin(numberArgument(arguments[0], "sin")));
+}
+
+inline Value builtinCos(const Value* arguments) {
+    return makeNumber(std::cos(numberArgument(arguments[0], "cos")));
+}
+
+inline Value builtinTan(const Value* arguments) {
+    return makeNumber(std::tan(numberArgument(arguments[0], "tan")));
+}
+
+inline Value builtinExp(const Value* arguments) {
+    return makeNumber(std::exp(numberArgument(arguments[0], "exp")));
+}
+
+inline Value builtinLog(const Value* arguments) {
+    return makeNumber(std::log(numberArgument(arguments[0], "log")));
+}
+
+// Formatting
+
+// The string 'print' would show for any value
+inline Value builtinStr(const Value* arguments) {
+    return makeString(valueToString(arguments[0]));
+}
+
+// A number with a fixed count of decimals, e.g. format(3.14159, 2) is "3.14"
+inline Value builtinFormat(const Value* arguments) {
+    double number = numberArgument(arguments[0], "format");
+    double decimals = numberArgument(arguments[1], "format");
+    if (decimals < 0 || decimals > 20 || decimals != std::floor(decimals)) {
+        throw std::runtime_error("format() expects a whole number of decimals from 0 to 20.");
+    }
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(static_cast<int>(decimals)) << number;
+    return makeString(stream.str());
+}
+
+struct Builtin {
+    const char* name;
+    int arity;
+    NativeFunction::Implementation implementation;
+};
+
+// Functions predefined as globals in every Session. They are declared before
+// any script, in this order, so they get the first global slots; scripts in
+// the bytecode cache rely on that, so bump BytecodeCache::kFormatVersion
+// whenever this list changes.
+inline const std::vector<Builtin>& builtins() {
+    static const std::vector<Builtin> list = {
+        {"sum", 1, builtinSum},
+        {"min", 1, builtinMin},
+        {"max", 1, builtinMax},
+        {"dot", 2, builtinDot},
+        {"scale", 2, builtinScale},
+        {"add", 2, builtinAdd},
+        {"mul", 2, builtinMul},
+
+        {"len", 1, builtinLen},
+        {"push", 2, builtinPush},
+        {"pop", 1, builtinPop},
+        {"slice", 3, builtinSlice},
+        {"find", 2, builtinFind},
+        {"split", 2, builtinSplit},
+        {"join", 2, builtinJoin},
+
+        {"keys", 1, builtinKeys},
+        {"values", 1, builtinValues},
+        {"has", 2, builtinHas},
+        {"remove", 2, builtinRemove},
+
+        {"abs", 1, builtinAbs},
+        {"sqrt", 1, builtinSqrt},
+        {"pow", 2, builtinPow},
+        {"floor", 1, builtinFloor},
+        {"ceil", 1, builtinCeil},
+        {"round", 1, builtinRound},
+        {"sin", 1, builtinSin},
+        {"cos", 1, builtinCos},
+        {"tan", 1, builtinTan},
+        {"exp", 1, builtinExp},
+        {"log", 1, builtinLog},
+
+        {"str", 1, builtinStr},
+        {"format", 2, builtinFormat},
+    };
+    return list;
+}
+
+#endif // BUILTINS_H
@@ -0,0 +1,634 @@
+// cache.cpp
+
+#include "cache.h"
+#include "intern.h"
+#include "map.h"
+#include "runtime.h"
+#include "source.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+
+// File layout, all integers little-endian:
+//   "AXC\0"  u32 format version  u64 source hash
+//   function: str name, u32 arity, u32 count + str local names,
+//             u32 length + code bytes, u32 count + constants,
+//             u32 count + str names, u32 count + (u32 offset, u32 line),
+//             u32 count + nested functions
+//   constant: u8 Value::Type, then f64 bits | u8 boolean | str
+//             | u32 count + (constant key, constant value) for a map;
+//             or kIntegerTag, then i64 bits
+//   str: u32 length + bytes
+
+namespace {
+
+const char kMagic[4] = {'A', 'X', 'C', '\0'};
+
+// Marks a number constant that is an integer
+const uint8_t kIntegerTag = 0x80 | static_cast<uint8_t>(Value::Type::NUMBER);
+
+class Writer {
+public:
+    std::string bytes;
+
+    void u8(uint8_t value) {
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            u8(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void u64(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            u8(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void str(const std::string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes.append(value);
+    }
+
+    bool writeFunction(const FunctionProto& function) {
+        str(function.name);
+        u32(static_cast<uint32_t>(function.arity));
+        u32(static_cast<uint32_t>(function.localNames.size()));
+        for (const auto& name : function.localNames) {
+            str(name);
+        }
+
+        const Chunk& chunk = function.chunk;
+        u32(static_cast<uint32_t>(chunk.code.size()));
+        bytes.append(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size());
+
+        u32(static_cast<uint32_t>(chunk.constants.size()));
+        for (const auto& constant : chunk.constants) {
+            if (!writeConstant(constant)) {
+                return false;
+            }
+        }
+
+        u32(static_cast<uint32_t>(chunk.names.size()));
+        for (const auto& name : chunk.names) {
+            str(name);
+        }
+
+        u32(static_cast<uint32_t>(chunk.lines.size()));
+        for (const auto& [offset, line] : chunk.lines) {
+            u32(offset);
+            u32(static_cast<uint32_t>(line));
+        }
+
+        u32(static_cast<uint32_t>(chunk.functions.size()));
+        for (const auto& nested : chunk.functions) {
+            if (!writeFunction(*nested)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool writeConstant(const Value& constant) {
+        if (constant.isInteger()) {
+            u8(kIntegerTag);
+            u64(static_cast<uint64_t>(constant.integer()));
+            return true;
+        }
+        u8(static_cast<uint8_t>(constant.type()));
+        switch (constant.type()) {
+            case Value::Type::NUMBER: {
+                uint64_t bits;
+                double number = constant.number();
+                std::memcpy(&bits, &number, sizeof(bits));
+                u64(bits);
+                return true;
+            }
+            case Value::Type::BOOLEAN:
+                u8(constant.boolean() ? 1 : 0);
+                return true;
+            case Value::Type::STRING:
+                str(asString(constant));
+                return true;
+            case Value::Type::MAP: {
+                // A SWITCH table: every entry is live, as nothing removes them
+                const ObjMap& map = asMap(constant);
+                u32(static_cast<uint32_t>(map.size()));
+                for (const auto& entry : map.entries()) {
+                    if (!writeConstant(entry.key) || !writeConstant(entry.value)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            default:
+                // The compiler emits no other constants
+                return false;
+        }
+    }
+};
+
+// Reads from the mapped file; any read past the end marks the data as bad
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data(data) {}
+
+    bool ok() const {
+        return !failed;
+    }
+
+    bool atEnd() const {
+        return position == data.size();
+    }
+
+    const char* take(size_t count) {
+        if (failed || data.size() - position < count) {
+            failed = true;
+            return nullptr;
+        }
+        const char* start = data.data() + position;
+        position += count;
+        return start;
+    }
+
+    uint8_t u8() {
+        const char* p = take(1);
+        return p ? static_cast<uint8_t>(*p) : 0;
+    }
+
+    uint32_t u32() {
+        const char* p = take(4);
+        uint32_t value = 0;
+        for (int i = 0; p && i < 4; i++) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t u64() {
+        const char* p = take(8);
+        uint64_t value = 0;
+        for (int i = 0; p && i < 8; i++) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string str() {
+        uint32_t length = u32();
+        const char* p = take(length);
+        return p ? std::string(p, length) : std::string();
+    }
+
+    std::shared_ptr<FunctionProto> readFunction() {
+        auto function = std::make_shared<FunctionProto>();
+        function->name = str();
+        function->arity = static_cast<int>(u32());
+        uint32_t localCount = u32();
+        for (uint32_t i = 0; ok() && i < localCount; i++) {
+            function->localNames.push_back(str());
+        }
+
+        Chunk& chunk = function->chunk;
+        uint32_t codeLength = u32();
+        const char* code = take(codeLength);
+        if (code != nullptr) {
+            chunk.code.assign(code, code + codeLength);
+        }
+
+        uint32_t constantCount = u32();
+        for (uint32_t i = 0; ok() && i < constantCount; i++) {
+            chunk.constants.push_back(readConstant());
+        }
+
+        uint32_t nameCount = u32();
+        for (uint32_t i = 0; ok() && i < nameCount; i++) {
+            chunk.names.push_back(str());
+        }
+
+        uint32_t lineCount = u32();
+        for (uint32_t i = 0; ok() && i < lineCount; i++) {
+            uint32_t offset = u32();
+            int line = static_cast<int>(u32());
+            chunk.lines.emplace_back(offset, line);
+        }
+
+        uint32_t functionCount = u32();
+        for (uint32_t i = 0; ok() && i < functionCount; i++) {
+            chunk.functions.push_back(readFunction());
+        }
+        return function;
+    }
+
+    Value readConstant() {
+        uint8_t tag = u8();
+        if (tag == kIntegerTag) {
+            return makeInteger(static_cast<int64_t>(u64()));
+        }
+        switch (static_cast<Value::Type>(tag)) {
+            case Value::Type::NUMBER: {
+                uint64_t bits = u64();
+                double number;
+                std::memcpy(&number, &bits, sizeof(number));
+                return makeNumber(number);
+            }
+            case Value::Type::BOOLEAN:
+                return makeBoolean(u8() != 0);
+            case Value::Type::STRING:
+                return makeString(StringTable::intern(str()));
+            case Value::Type::MAP: {
+                Value map = makeMap();
+                uint32_t count = u32();
+                for (uint32_t i = 0; ok() && i < count; i++) {
+                    Value key = readConstant();
+                    Value value = readConstant();
+                    if (!isNumber(key) && !isString(key) && !isBoolean(key)) {
+                        failed = true;
+                    }
+                    if (ok()) {
+                        asMap(map).set(key, value);
+                    }
+                }
+                return map;
+            }
+            default:
+                failed = true;
+                return Value();
+        }
+    }
+
+private:
+    std::string_view data;
+    size_t position = 0;
+    bool failed = false;
+};
+
+// Checks the code of a loaded script before the VM runs it. The VM trusts
+// its operands, so every index must be inside its table, every jump must
+// land on an instruction, and no path may pop more than it pushed or run
+// off the end of the code. The compiler's output always passes.
+class Verifier {
+public:
+    static bool check(const FunctionProto& script) {
+        return Verifier(script.localNames.size()).function(script, 0);
+    }
+
+private:
+    size_t globalCount;
+
+    explicit Verifier(size_t globalCount) : globalCount(globalCount) {}
+
+    // One decoded instruction
+    struct Instruction {
+        OpCode op;
+        size_t next;          // offset of the following instruction
+        int pops = 0;         // values it needs on the stack
+        int pushes = 0;
+        bool falls = true;    // whether it can continue at 'next'
+        std::vector<size_t> targets;
+    };
+
+    // 'level' counts the functions this one is nested in; the script is 0
+    bool function(const FunctionProto& proto, int level) {
+        // At the top level the local slots are the globals
+        size_t localCount = level == 0 ? globalCount : proto.localNames.size();
+        if (proto.arity < 0 || static_cast<size_t>(proto.arity) > localCount) {
+            return false;
+        }
+
+        const Chunk& chunk = proto.chunk;
+        std::vector<Instruction> instructions;
+        std::vector<int> indexAt(chunk.code.size(), -1);
+        size_t offset = 0;
+        while (offset < chunk.code.size()) {
+            Instruction instruction;
+            if (!decode(chunk, offset, localCount, level, instruction)) {
+                return false;
+            }
+            indexAt[offset] = static_cast<int>(instructions.size());
+            offset = instruction.next;
+            instructions.push_back(std::move(instruction));
+        }
+
+        // Follow every path from the start, giving each instruction the one
+        // stack height all paths into it agree on
+        std::vector<int> heights(instructions.size(), -1);
+        std::vector<size_t> pending;
+        auto reach = [&](size_t target, int height) {
+            if (target >= chunk.code.size() || indexAt[target] < 0) {
+                return false;
+            }
+            int& known = heights[indexAt[target]];
+            if (known < 0) {
+                known = height;
+                pending.push_back(indexAt[target]);
+            }
+            return known == height;
+        };
+        if (instructions.empty() || !reach(0, 0)) {
+            return false;
+        }
+        while (!pending.empty()) {
+            const Instruction& instruction = instructions[pending.back()];
+            int height = heights[pending.back()];
+            pending.pop_back();
+            if (height < instruction.pops) {
+                return false;
+            }
+            height += instruction.pushes - instruction.pops;
+            if (instruction.falls && !reach(instruction.next, height)) {
+                return false;
+            }
+            for (size_t target : instruction.targets) {
+                if (!reach(target, height)) {
+                    return false;
+                }
+            }
+        }
+
+        for (const auto& nested : chunk.functions) {
+            if (nested == nullptr || !function(*nested, level + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool decode(const Chunk& chunk, size_t offset, size_t localCount, int level, Instruction& out) {
+        const std::vector<uint8_t>& code = chunk.code;
+        if (code[offset] > static_cast<uint8_t>(OpCode::ERROR)) {
+            return false;
+        }
+        out.op = static_cast<OpCode>(code[offset]);
+        size_t position = offset + 1;
+        bool fits = true;
+        auto byte = [&]() -> size_t {
+            if (position + 1 > code.size()) {
+                fits = false;
+                return 0;
+            }
+            return code[position++];
+        };
+        auto u16 = [&]() -> size_t {
+            if (position + 2 > code.size()) {
+                fits = false;
+                return 0;
+            }
+            position += 2;
+            return static_cast<size_t>(code[position - 2] << 8 | code[position - 1]);
+        };
+        auto constant = [&](size_t index) {
+            return index < chunk.constants.size();
+        };
+        auto forward = [&](size_t distance) {
+            out.targets.push_back(position + distance);
+        };
+        // Loop operands: [u8 down][u8 LoopVar][u16 slot]
+        auto loopOperands = [&]() {
+            byte();
+            size_t var = byte();
+            size_t slot = u16();
+            return var == static_cast<size_t>(LoopVar::NONE) ||
+                   (var == static_cast<size_t>(LoopVar::LOCAL) && slot < localCount) ||
+                   (var == static_cast<size_t>(LoopVar::GLOBAL) && slot < globalCount);
+        };
+
+        bool valid = true;
+        switch (out.op) {
+            case OpCode::CONSTANT: {
+                // A SWITCH table never reaches the stack, where the script
+                // could change the jumps it holds
+                size_t index = u16();
+                valid = constant(index) && !isMap(chunk.constants[index]);
+                out.pushes = 1;
+                break;
+            }
+            case OpCode::POP:
+            case OpCode::PRINT:
+                out.pops = 1;
+                break;
+            case OpCode::DEFINE_GLOBAL:
+            case OpCode::GET_GLOBAL:
+            case OpCode::SET_GLOBAL:
+            case OpCode::DEFINE_LOCAL:
+            case OpCode::GET_LOCAL:
+            case OpCode::SET_LOCAL: {
+                bool global = out.op == OpCode::DEFINE_GLOBAL || out.op == OpCode::GET_GLOBAL ||
+                              out.op == OpCode::SET_GLOBAL;
+                valid = u16() < (global ? globalCount : localCount);
+                if (out.op == OpCode::DEFINE_GLOBAL || out.op == OpCode::DEFINE_LOCAL) {
+                    out.pops = 1;
+                } else if (out.op == OpCode::SET_GLOBAL || out.op == OpCode::SET_LOCAL) {
+                    out.pops = 1;
+                    out.pushes = 1;
+                } else {
+                    out.pushes = 1;
+                }
+                break;
+            }
+            case OpCode::GET_OUTER:
+            case OpCode::SET_OUTER: {
+                // The slot is checked when it is used; the depth and the
+                // name are not
+                size_t depth = byte();
+                u16();
+                valid = depth <= static_cast<size_t>(level) && u16() < chunk.names.size();
+                out.pops = out.op == OpCode::SET_OUTER ? 1 : 0;
+                out.pushes = 1;
+                break;
+            }
+            case OpCode::ADD:
+            case OpCode::SUBTRACT:
+            case OpCode::MULTIPLY:
+            case OpCode::DIVIDE:
+            case OpCode::MODULO:
+            case OpCode::GREATER:
+            case OpCode::GREATER_EQUAL:
+            case OpCode::LESS:
+            case OpCode::LESS_EQUAL:
+            case OpCode::EQUAL:
+            case OpCode::NOT_EQUAL:
+            case OpCode::INDEX:
+                out.pops = 2;
+                out.pushes = 1;
+                break;
+            case OpCode::SET_INDEX:
+                out.pops = 3;
+                out.pushes = 1;
+                break;
+            case OpCode::ARRAY:
+                out.pops = static_cast<int>(u16());
+                out.pushes = 1;
+                break;
+            case OpCode::FIXED_ARRAY:
+                u16();
+                out.pops = static_cast<int>(u16());
+                out.pushes = 1;
+                break;
+            case OpCode::MAP:
+                out.pops = 2 * static_cast<int>(u16());
+                out.pushes = 1;
+                break;
+            case OpCode::JUMP:
+                forward(u16());
+                out.falls = false;
+                break;
+            case OpCode::JUMP_IF_FALSE:
+                out.pops = 1;
+                forward(u16());
+                break;
+            case OpCode::JUMP_UNLESS:
+                valid = byte() <= static_cast<size_t>(Comparison::LESS_EQUAL);
+                out.pops = 2;
+                forward(u16());
+                break;
+            case OpCode::JUMP_UNLESS_LOCAL:
+            case OpCode::JUMP_UNLESS_GLOBAL: {
+                bool comparison = byte() <= static_cast<size_t>(Comparison::LESS_EQUAL);
+                size_t slot = u16();
+                valid = comparison && constant(u16()) &&
+                        slot < (out.op == OpCode::JUMP_UNLESS_LOCAL ? localCount : globalCount);
+                forward(u16());
+                break;
+            }
+            case OpCode::SWITCH: {
+                size_t table = u16();
+                size_t distance = u16();
+                out.pops = 1;
+                out.falls = false;
+                if (!fits || !constant(table) || !isMap(chunk.constants[table])) {
+                    return false;
+                }
+                forward(distance);
+                // Each entry is a jump distance the VM reads as a u16
+                for (const auto& entry : asMap(chunk.constants[table]).entries()) {
+                    if (entry.key.isUndefined()) {
+                        continue;
+                    }
+                    double number = isNumber(entry.value) ? entry.value.number() : -1;
+                    if (!(number >= 0 && number <= 0xffff && number == static_cast<uint16_t>(number))) {
+                        return false;
+                    }
+                    forward(static_cast<uint16_t>(number));
+                }
+                break;
+            }
+            case OpCode::LOOP_ENTER:
+                valid = loopOperands();
+                out.pops = 3;
+                out.pushes = 3;
+                forward(u16());
+                break;
+            case OpCode::LOOP_NEXT: {
+                valid = loopOperands();
+                out.pops = 3;
+                out.pushes = 3;
+                size_t distance = u16();
+                valid = valid && distance <= position;
+                out.targets.push_back(position - distance);
+                break;
+            }
+            case OpCode::CLOSURE:
+                valid = u16() < chunk.functions.size();
+                out.pushes = 1;
+                break;
+            case OpCode::CALL:
+                out.pops = static_cast<int>(byte()) + 1;
+                out.pushes = 1;
+                break;
+            case OpCode::RETURN_VALUE:
+                out.pops = 1;
+                out.falls = false;
+                break;
+            case OpCode::INPUT:
+                out.pushes = 1;
+                break;
+            case OpCode::ERROR: {
+                size_t message = u16();
+                valid = constant(message) && isString(chunk.constants[message]);
+                out.falls = false;
+                break;
+            }
+        }
+        out.next = position;
+        return fits && valid;
+    }
+};
+
+} // namespace
+
+std::string BytecodeCache::pathFor(const std::string& sourcePath) {
+    size_t nameStart = sourcePath.find_last_of('/');
+    nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+
+    // Replace the extension, but not the leading dot of a hidden file
+    size_t dot = sourcePath.find_last_of('.');
+    if (dot == std::string::npos || dot <= nameStart) {
+        return sourcePath + ".axc";
+    }
+    return sourcePath.substr(0, dot) + ".axc";
+}
+
+uint64_t BytecodeCache::hash(std::string_view source) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : source) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::shared_ptr<FunctionProto> BytecodeCache::load(const std::string& path, uint64_t sourceHash) {
+    SourceBuffer file;
+    if (access(path.c_str(), R_OK) != 0 || !file.open(path)) {
+        return nullptr;
+    }
+
+    Reader reader(file.text());
+    const char* magic = reader.take(sizeof(kMagic));
+    if (magic == nullptr || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        return nullptr;
+    }
+    if (reader.u32() != kFormatVersion || reader.u64() != sourceHash) {
+        return nullptr;
+    }
+
+    auto script = reader.readFunction();
+    if (!reader.ok() || !reader.atEnd() || !Verifier::check(*script)) {
+        return nullptr;
+    }
+    return script;
+}
+
+void BytecodeCache::save(const std::string& path, uint64_t sourceHash, const FunctionProto& script) {
+    Writer writer;
+    writer.bytes.append(kMagic, sizeof(kMagic));
+    writer.u32(kFormatVersion);
+    writer.u64(sourceHash);
+    if (!writer.writeFunction(script)) {
+        return;
+    }
+
+    // Write to a temporary file and rename it, so a concurrent run never
+    // sees a partial cache
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(writer.bytes.data(), writer.bytes.size());
+        if (!file) {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+    }
+}
@@ -0,0 +1,32 @@
+// cache.h
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "chunk.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Compiled scripts saved next to their source (script.axp -> script.axc) so
+// later runs can skip lexing, parsing and compiling. A cache file is only
+// used when the hash of the current source matches the one it was built from.
+class BytecodeCache
+{
+public:
+    // Bump whenever the instruction set or the file layout changes
+    static const uint32_t kFormatVersion = 10;
+
+    static std::string pathFor(const std::string& sourcePath);
+
+    // 64-bit FNV-1a of the source text
+    static uint64_t hash(std::string_view source);
+
+    // Returns null if the file is missing, stale or malformed
+    static std::shared_ptr<FunctionProto> load(const std::string& path, uint64_t sourceHash);
+
+    // Best effort: a script that cannot be cached still runs
+    static void save(const std::string& path, uint64_t sourceHash, const FunctionProto& script);
+};
+
+#endif // CACHE_H
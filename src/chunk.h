@@ -0,0 +1,143 @@
+// chunk.h
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "environment.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bytecode instructions executed by the VM. Operands follow the opcode
+// in the code stream; 16-bit operands are stored big-endian.
+enum class OpCode : uint8_t {
+    CONSTANT,       // [u16 constant]  push constants[i]
+    POP,            //                 discard the top of the stack
+
+    // Variables live in slots assigned by the Resolver. DEFINE pops the value,
+    // SET leaves it on the stack.
+    DEFINE_GLOBAL,  // [u16 slot]
+    GET_GLOBAL,     // [u16 slot]
+    SET_GLOBAL,     // [u16 slot]
+    DEFINE_LOCAL,   // [u16 slot]
+    GET_LOCAL,      // [u16 slot]
+    SET_LOCAL,      // [u16 slot]
+    GET_OUTER,      // [u8 depth][u16 slot][u16 name]  slot of an enclosing function's scope
+    SET_OUTER,      // [u8 depth][u16 slot][u16 name]
+
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MODULO,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+
+    ARRAY,          // [u16 count]              build an array from the top count values
+    FIXED_ARRAY,    // [u16 size][u16 count]    same, padded with zeros or truncated to size
+    MAP,            // [u16 count]              build a map from the top count key, value pairs
+    INDEX,          //                          array or map, index -> element
+    SET_INDEX,      //                          array or map, index, value -> value
+
+    JUMP,           // [u16 offset]    jump forward
+    JUMP_IF_FALSE,  // [u16 offset]    pop the condition, jump forward if it is falsy
+
+    // Fused compare-and-branch for compeq, compg and the rest: jump forward
+    // unless 'left <Comparison> right', without pushing a boolean in between
+    JUMP_UNLESS,         // [u8 Comparison][u16 offset]                    pop left and right
+    JUMP_UNLESS_LOCAL,   // [u8 Comparison][u16 slot][u16 constant][u16 offset]  local slot against a constant
+    JUMP_UNLESS_GLOBAL,  // [u8 Comparison][u16 slot][u16 constant][u16 offset]  global slot against a constant
+
+    // A compeq chain over one variable (see dispatch.h): pop the value and
+    // jump forward by the number the map constant holds for it, or by offset
+    SWITCH,         // [u16 constant][u16 offset]
+
+    // Counting loops keep from (used as the counter), to and step on the
+    // stack and copy the counter into the loop variable's slot, if it has one
+    LOOP_ENTER,     // [u8 down][u8 LoopVar][u16 slot][u16 offset]  check the operands, jump forward if already past 'to'
+    LOOP_NEXT,      // [u8 down][u8 LoopVar][u16 slot][u16 offset]  advance the counter, jump backward unless past 'to'
+
+    CLOSURE,        // [u16 function]  push a function closing over the current environment
+    CALL,           // [u8 argc]       callee, args... -> result
+    RETURN_VALUE,   //                 return the top of the stack to the caller
+
+    PRINT,          //                 pop and print the top of the stack
+    INPUT,          //                 read a line from stdin and push it
+    ERROR           // [u16 constant]  raise a runtime error with a string constant
+};
+
+// Where LOOP_ENTER and LOOP_NEXT store the counter
+enum class LoopVar : uint8_t {
+    NONE,           // the loop variable is never read
+    LOCAL,
+    GLOBAL
+};
+
+struct FunctionProto;
+
+// A compiled unit of bytecode together with the tables its operands index into
+struct Chunk {
+    std::vector<uint8_t> code;
+    std::vector<Value> constants;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<FunctionProto>> functions;
+
+    // (code offset, source line) at each point where the line changes
+    std::vector<std::pair<uint32_t, int>> lines;
+
+    void write(uint8_t byte) {
+        code.push_back(byte);
+    }
+
+    void write(OpCode op) {
+        code.push_back(static_cast<uint8_t>(op));
+    }
+
+    void writeShort(uint16_t value) {
+        code.push_back(static_cast<uint8_t>((value >> 8) & 0xff));
+        code.push_back(static_cast<uint8_t>(value & 0xff));
+    }
+
+    void patchShort(size_t offset, uint16_t value) {
+        code[offset] = static_cast<uint8_t>((value >> 8) & 0xff);
+        code[offset + 1] = static_cast<uint8_t>(value & 0xff);
+    }
+
+    // Code written from here on comes from 'line'
+    void markLine(int line) {
+        if (line <= 0 || (!lines.empty() && lines.back().second == line)) {
+            return;
+        }
+        uint32_t offset = static_cast<uint32_t>(code.size());
+        if (!lines.empty() && lines.back().first == offset) {
+            lines.back().second = line;
+        } else {
+            lines.emplace_back(offset, line);
+        }
+    }
+
+    // Source line of the instruction at 'offset', 0 if unknown
+    int lineAt(size_t offset) const {
+        auto it = std::upper_bound(lines.begin(), lines.end(), offset,
+                                   [](size_t value, const std::pair<uint32_t, int>& entry) {
+                                       return value < entry.first;
+                                   });
+        return it == lines.begin() ? 0 : std::prev(it)->second;
+    }
+};
+
+// A compiled function. Parameters take the first of its local slots. For
+// the top-level script the local slots are the global variables.
+struct FunctionProto {
+    std::string name;
+    int arity = 0;
+    std::vector<std::string> localNames;
+    Chunk chunk;
+};
+
+#endif // CHUNK_H
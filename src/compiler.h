@@ -0,0 +1,623 @@
+// compiler.h
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "visitor.h"
+#include "ast.h"
+#include "chunk.h"
+#include "dispatch.h"
+#include "runtime.h"
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Compiles the AST produced by the Parser into bytecode for the VM.
+// Expressions leave exactly one value on the stack, statements leave the
+// stack as they found it.
+class Compiler : public Visitor
+{
+private:
+    // Jumps waiting for the end of the enclosing loop
+    struct LoopContext {
+        std::vector<size_t> breakJumps;
+        std::vector<size_t> continueJumps;
+    };
+
+    FunctionProto* function = nullptr;
+    int level = 0;  // Function nesting; variables resolved at this depth are globals
+    std::unordered_map<std::string, uint16_t> nameIndices;
+    std::map<std::tuple<Value::Type, bool, uint64_t>, uint16_t> constantIndices;
+    std::vector<LoopContext> loops;
+
+public:
+    // Compile statements that have been through the Resolver
+    std::shared_ptr<FunctionProto> compile(const std::vector<StmtPtr>& statements,
+                                           const std::vector<std::string>& globalNames) {
+        auto script = std::make_shared<FunctionProto>();
+        script->name = "script";
+        script->localNames = globalNames;
+        function = script.get();
+
+        for (const auto& statement : statements) {
+            compileStmt(statement);
+        }
+        emitReturn();
+
+        function = nullptr;
+        return script;
+    }
+
+    void visit(NumberExpr *expr) override {
+        emitConstant(expr->literal());
+    }
+
+    void visit(StringExpr *expr) override {
+        emitConstant(makeString(expr->value));
+    }
+
+    void visit(BooleanExpr *expr) override {
+        emitConstant(makeBoolean(expr->value));
+    }
+
+    void visit(VariableExpr *expr) override {
+        emitVariable(OpCode::GET_GLOBAL, OpCode::GET_LOCAL, OpCode::GET_OUTER,
+                     expr->depth, expr->slot, expr->name.lexeme);
+    }
+
+    void visit(BinaryExpr *expr) override {
+        compileExpr(expr->left);
+        compileExpr(expr->right);
+
+        switch (expr->op.type) {
+            case TokenType::PLUS: emit(OpCode::ADD); break;
+            case TokenType::MINUS: emit(OpCode::SUBTRACT); break;
+            case TokenType::STAR: emit(OpCode::MULTIPLY); break;
+            case TokenType::SLASH: emit(OpCode::DIVIDE); break;
+            case TokenType::PERCENT: emit(OpCode::MODULO); break;
+            case TokenType::GREATER: emit(OpCode::GREATER); break;
+            case TokenType::GREATER_EQUAL: emit(OpCode::GREATER_EQUAL); break;
+            case TokenType::LESS: emit(OpCode::LESS); break;
+            case TokenType::LESS_EQUAL: emit(OpCode::LESS_EQUAL); break;
+            case TokenType::EQUAL_EQUAL: emit(OpCode::EQUAL); break;
+            case TokenType::BANG_EQUAL: emit(OpCode::NOT_EQUAL); break;
+            default:
+                emitError("Invalid binary operator");
+        }
+    }
+
+    void visit(AssignExpr* expr) override {
+        compileExpr(expr->value);
+        emitVariable(OpCode::SET_GLOBAL, OpCode::SET_LOCAL, OpCode::SET_OUTER,
+                     expr->depth, expr->slot, expr->name.lexeme);
+    }
+
+    void visit(CompEqExpr* expr) override {
+        compileExpr(expr->left);
+        compileExpr(expr->right);
+        emit(OpCode::EQUAL);
+    }
+
+    void visit(ArrayExpr* expr) override {
+        for (const auto& element : expr->elements) {
+            compileExpr(element);
+        }
+        emit(OpCode::ARRAY);
+        chunk().writeShort(checkShort(expr->elements.size(), "Too many elements in array literal."));
+    }
+
+    void visit(FixedArrayExpr* expr) override {
+        for (const auto& element : expr->elements) {
+            compileExpr(element);
+        }
+        emit(OpCode::FIXED_ARRAY);
+        chunk().writeShort(checkShort(expr->size, "Fixed array size is too large."));
+        chunk().writeShort(checkShort(expr->elements.size(), "Too many elements in array literal."));
+    }
+
+    void visit(MapExpr* expr) override {
+        for (size_t i = 0; i < expr->keys.size(); i++) {
+            compileExpr(expr->keys[i]);
+            compileExpr(expr->values[i]);
+        }
+        emit(OpCode::MAP);
+        chunk().writeShort(checkShort(expr->keys.size(), "Too many entries in map literal."));
+    }
+
+    void visit(IndexExpr* expr) override {
+        compileExpr(expr->object);
+        compileExpr(expr->index);
+        emit(OpCode::INDEX);
+    }
+
+    void visit(AssignIndexExpr* expr) override {
+        compileExpr(expr->object);
+        compileExpr(expr->index);
+        compileExpr(expr->value);
+        emit(OpCode::SET_INDEX);
+    }
+
+    void visit(CallExpr* expr) override {
+        compileExpr(expr->callee);
+        for (const auto& arg : expr->arguments) {
+            compileExpr(arg);
+        }
+        chunk().markLine(expr->paren.line);
+        emit(OpCode::CALL);
+        chunk().write(static_cast<uint8_t>(expr->arguments.size()));
+    }
+
+    void visit(PrintStmt *stmt) override {
+        compileExpr(stmt->expression);
+        emit(OpCode::PRINT);
+    }
+
+    void visit(VarStmt *stmt) override {
+        if (stmt->initializer != nullptr) {
+            compileExpr(stmt->initializer);
+        } else {
+            emitConstant(makeInteger(0));
+        }
+        emitDefine(stmt->slot);
+    }
+
+    void visit(InputStmt *stmt) override {
+        emit(OpCode::INPUT);
+        emitDefine(stmt->slot);
+    }
+
+    void visit(BlockStmt* stmt) override {
+        for (const auto& statement : stmt->statements) {
+            compileStmt(statement);
+        }
+    }
+
+    void visit(LoopStmt* stmt) override {
+        // from, to and step stay on the stack for the duration of the loop
+        compileExpr(stmt->from);
+        compileExpr(stmt->to);
+        if (stmt->step) {
+            compileExpr(stmt->step);
+        } else {
+            emitConstant(makeInteger(1));
+        }
+
+        uint8_t down = stmt->isDownward ? 1 : 0;
+        LoopVar var = !stmt->varUsed ? LoopVar::NONE : level == 0 ? LoopVar::GLOBAL : LoopVar::LOCAL;
+        uint16_t slot = checkShort(stmt->slot, "Too many variables in one scope.");
+
+        emit(OpCode::LOOP_ENTER);
+        chunk().write(down);
+        chunk().write(static_cast<uint8_t>(var));
+        chunk().writeShort(slot);
+        size_t exitJump = emitJumpOperand();
+
+        size_t loopStart = chunk().code.size();
+
+        loops.emplace_back();
+        compileStmt(stmt->body);
+        LoopContext loop = std::move(loops.back());
+        loops.pop_back();
+
+        // 'continue' lands on the counter update
+        for (size_t jump : loop.continueJumps) {
+            patchJump(jump);
+        }
+
+        // The counter update belongs to the loop header
+        chunk().markLine(stmt->line);
+        emit(OpCode::LOOP_NEXT);
+        chunk().write(down);
+        chunk().write(static_cast<uint8_t>(var));
+        chunk().writeShort(slot);
+        emitBackJump(loopStart);
+
+        patchJump(exitJump);
+        for (size_t jump : loop.breakJumps) {
+            patchJump(jump);
+        }
+
+        // Drop counter, to and step
+        emit(OpCode::POP);
+        emit(OpCode::POP);
+        emit(OpCode::POP);
+    }
+
+    void visit(BreakStmt* stmt) override {
+        if (loops.empty()) {
+            emitError("Cannot use 'break' outside of a loop.");
+            return;
+        }
+        emit(OpCode::JUMP);
+        loops.back().breakJumps.push_back(emitJumpOperand());
+    }
+
+    void visit(ContinueStmt* stmt) override {
+        if (loops.empty()) {
+            emitError("Cannot use 'continue' outside of a loop.");
+            return;
+        }
+        emit(OpCode::JUMP);
+        loops.back().continueJumps.push_back(emitJumpOperand());
+    }
+
+    void visit(ExpressionStmt* stmt) override {
+        compileExpr(stmt->expression);
+        emit(OpCode::POP);
+    }
+
+    void visit(CompareStmt* stmt) override {
+        Value table = dispatchTable(*stmt);
+        if (!table.isUndefined()) {
+            compileDispatch(stmt, table);
+            return;
+        }
+
+        std::vector<size_t> endJumps;
+        for (const auto& arm : stmt->arms) {
+            size_t nextJump = emitJumpUnless(comparisonFor(arm.op), arm.left, arm.right);
+            compileStmt(arm.body);
+            if (&arm != &stmt->arms.back() || stmt->elseBranch) {
+                emit(OpCode::JUMP);
+                endJumps.push_back(emitJumpOperand());
+            }
+            patchJump(nextJump);
+        }
+        compileStmt(stmt->elseBranch);
+        for (size_t jump : endJumps) {
+            patchJump(jump);
+        }
+    }
+
+    void visit(AndStmt* stmt) override {
+        std::vector<size_t> elseJumps;
+
+        compileExpr(stmt->left);
+        emit(OpCode::JUMP_IF_FALSE);
+        elseJumps.push_back(emitJumpOperand());
+
+        compileExpr(stmt->right);
+        emit(OpCode::JUMP_IF_FALSE);
+        elseJumps.push_back(emitJumpOperand());
+
+        compileBranches(stmt->thenBranch, stmt->elseBranch, elseJumps);
+    }
+
+    void visit(OrStmt* stmt) override {
+        std::vector<size_t> elseJumps;
+
+        // A truthy left side skips straight to the then branch
+        compileExpr(stmt->left);
+        emit(OpCode::JUMP_IF_FALSE);
+        size_t rightJump = emitJumpOperand();
+        emit(OpCode::JUMP);
+        size_t thenJump = emitJumpOperand();
+
+        patchJump(rightJump);
+        compileExpr(stmt->right);
+        emit(OpCode::JUMP_IF_FALSE);
+        elseJumps.push_back(emitJumpOperand());
+
+        patchJump(thenJump);
+        compileBranches(stmt->thenBranch, stmt->elseBranch, elseJumps);
+    }
+
+    void visit(NotStmt* stmt) override {
+        // The then branch runs when the operand is falsy
+        compileExpr(stmt->operand);
+        emit(OpCode::JUMP_IF_FALSE);
+        size_t thenJump = emitJumpOperand();
+
+        compileStmt(stmt->elseBranch);
+        emit(OpCode::JUMP);
+        size_t endJump = emitJumpOperand();
+
+        patchJump(thenJump);
+        compileStmt(stmt->thenBranch);
+        patchJump(endJump);
+    }
+
+    void visit(AndConditionStmt* stmt) override {
+        std::vector<size_t> elseJumps;
+        for (const auto& condition : stmt->conditions) {
+            elseJumps.push_back(emitConditionJump(condition));
+        }
+        compileBranches(stmt->thenBranch, stmt->elseBranch, elseJumps);
+    }
+
+    void visit(OrConditionStmt* stmt) override {
+        std::vector<size_t> thenJumps;
+        for (const auto& condition : stmt->conditions) {
+            size_t nextJump = emitConditionJump(condition);
+            emit(OpCode::JUMP);
+            thenJumps.push_back(emitJumpOperand());
+            patchJump(nextJump);
+        }
+
+        // None of the conditions held
+        compileStmt(stmt->elseBranch);
+        emit(OpCode::JUMP);
+        size_t endJump = emitJumpOperand();
+
+        for (size_t jump : thenJumps) {
+            patchJump(jump);
+        }
+        compileStmt(stmt->thenBranch);
+        patchJump(endJump);
+    }
+
+    void visit(FunctionStmt* stmt) override {
+        auto proto = std::make_shared<FunctionProto>();
+        proto->name = std::string(stmt->name.lexeme);
+        proto->arity = static_cast<int>(stmt->parameters.size());
+        proto->localNames = stmt->localNames;
+
+        // Compile the body into its own chunk; loops do not reach across functions
+        FunctionProto* enclosing = function;
+        auto enclosingNames = std::move(nameIndices);
+        auto enclosingConstants = std::move(constantIndices);
+        auto enclosingLoops = std::move(loops);
+        function = proto.get();
+        level++;
+        nameIndices.clear();
+        constantIndices.clear();
+        loops.clear();
+
+        for (const auto& statement : stmt->body) {
+            compileStmt(statement);
+        }
+        emitReturn();
+
+        function = enclosing;
+        level--;
+        nameIndices = std::move(enclosingNames);
+        constantIndices = std::move(enclosingConstants);
+        loops = std::move(enclosingLoops);
+
+        chunk().functions.push_back(proto);
+        emit(OpCode::CLOSURE);
+        chunk().writeShort(checkShort(chunk().functions.size() - 1, "Too many functions in one chunk."));
+        emitDefine(stmt->slot);
+    }
+
+    void visit(ReturnStmt* stmt) override {
+        if (stmt->value != nullptr) {
+            compileExpr(stmt->value);
+        } else {
+            emitConstant(makeInteger(0));
+        }
+        emit(OpCode::RETURN_VALUE);
+    }
+
+private:
+    Chunk& chunk() {
+        return function->chunk;
+    }
+
+    void compileExpr(const ExprPtr& expr) {
+        expr->accept(this);
+    }
+
+    void compileStmt(const StmtPtr& stmt) {
+        if (stmt) {
+            chunk().markLine(stmt->line);
+            stmt->accept(this);
+        }
+    }
+
+    // Conditions of and/or chains are expression statements whose value decides
+    // the branch. Emit a jump taken when the condition fails and return its
+    // operand for patchJump.
+    size_t emitConditionJump(const StmtPtr& condition) {
+        auto* exprStmt = dynamic_cast<ExpressionStmt*>(condition.get());
+        if (exprStmt == nullptr) {
+            throw std::runtime_error("Unsupported condition in logical statement.");
+        }
+        if (auto* comparison = dynamic_cast<CompEqExpr*>(exprStmt->expression.get())) {
+            return emitJumpUnless(Comparison::EQUAL, comparison->left, comparison->right);
+        }
+        compileExpr(exprStmt->expression);
+        emit(OpCode::JUMP_IF_FALSE);
+        return emitJumpOperand();
+    }
+
+    // The arm is picked by looking the variable up in 'table', a map from
+    // each literal to its arm's index. The indices are replaced by the
+    // distance from the end of the SWITCH to the arm's code.
+    void compileDispatch(CompareStmt* stmt, Value& table) {
+        compileExpr(stmt->arms[0].left);
+        emit(OpCode::SWITCH);
+        chunk().writeShort(addConstant(table));
+        size_t defaultJump = emitJumpOperand();
+        size_t base = chunk().code.size();
+
+        std::vector<size_t> starts;
+        std::vector<size_t> endJumps;
+        for (const auto& arm : stmt->arms) {
+            starts.push_back(chunk().code.size() - base);
+            compileStmt(arm.body);
+            emit(OpCode::JUMP);
+            endJumps.push_back(emitJumpOperand());
+        }
+        patchJump(defaultJump);
+        compileStmt(stmt->elseBranch);
+        for (size_t jump : endJumps) {
+            patchJump(jump);
+        }
+
+        ObjMap& targets = asMap(table);
+        std::vector<Value> keys;
+        for (const auto& entry : targets.entries()) {
+            keys.push_back(entry.key);
+        }
+        for (const Value& key : keys) {
+            size_t arm = static_cast<size_t>(asNumber(*targets.find(key)));
+            targets.set(key, makeNumber(checkShort(starts[arm], "Too much code to jump over.")));
+        }
+    }
+
+    // Emit a jump taken unless 'left <op> right' and return its operand for
+    // patchJump. A local or global compared against a literal is tested in
+    // place; anything else is evaluated onto the stack first.
+    size_t emitJumpUnless(Comparison op, const ExprPtr& left, const ExprPtr& right) {
+        auto* variable = dynamic_cast<VariableExpr*>(left.get());
+        Value constant;
+        bool inPlace = variable != nullptr && (variable->depth == level || variable->depth == 0) &&
+                       literalValue(right, constant);
+        if (!inPlace) {
+            compileExpr(left);
+            compileExpr(right);
+            emit(OpCode::JUMP_UNLESS);
+            chunk().write(static_cast<uint8_t>(op));
+            return emitJumpOperand();
+        }
+
+        bool global = variable->depth == level;
+        emit(global ? OpCode::JUMP_UNLESS_GLOBAL : OpCode::JUMP_UNLESS_LOCAL);
+        chunk().write(static_cast<uint8_t>(op));
+        chunk().writeShort(checkShort(variable->slot, global ? "Too many global variables." : "Too many local variables."));
+        chunk().writeShort(addConstant(constant));
+        return emitJumpOperand();
+    }
+
+    // Emit the then branch, then the else branch as the target of elseJumps
+    void compileBranches(const StmtPtr& thenBranch, const StmtPtr& elseBranch,
+                         const std::vector<size_t>& elseJumps) {
+        compileStmt(thenBranch);
+        if (elseBranch) {
+            emit(OpCode::JUMP);
+            size_t endJump = emitJumpOperand();
+            for (size_t jump : elseJumps) {
+                patchJump(jump);
+            }
+            compileStmt(elseBranch);
+            patchJump(endJump);
+        } else {
+            for (size_t jump : elseJumps) {
+                patchJump(jump);
+            }
+        }
+    }
+
+    void emit(OpCode op) {
+        chunk().write(op);
+    }
+
+    // Pick the global, local or enclosing-scope form of a variable access
+    void emitVariable(OpCode globalOp, OpCode localOp, OpCode outerOp,
+                      int depth, int slot, std::string_view name) {
+        if (depth == level) {
+            emit(globalOp);
+            chunk().writeShort(checkShort(slot, "Too many global variables."));
+        } else if (depth == 0) {
+            emit(localOp);
+            chunk().writeShort(checkShort(slot, "Too many local variables."));
+        } else {
+            emit(outerOp);
+            chunk().write(static_cast<uint8_t>(depth));
+            chunk().writeShort(checkShort(slot, "Too many local variables."));
+            chunk().writeShort(nameConstant(name));
+        }
+    }
+
+    // Declarations always bind in the current scope
+    void emitDefine(int slot) {
+        emit(level == 0 ? OpCode::DEFINE_GLOBAL : OpCode::DEFINE_LOCAL);
+        chunk().writeShort(checkShort(slot, "Too many variables in one scope."));
+    }
+
+    void emitConstant(const Value& value) {
+        emit(OpCode::CONSTANT);
+        chunk().writeShort(addConstant(value));
+    }
+
+    void emitError(const std::string& message) {
+        emit(OpCode::ERROR);
+        chunk().writeShort(addConstant(makeString(StringTable::intern(message))));
+    }
+
+    // Each distinct literal is stored once per chunk. Strings are interned,
+    // so they are the same constant exactly when they are the same object;
+    // numbers match by bit pattern, which keeps 0 and -0 apart, and by
+    // whether they are integers.
+    uint16_t addConstant(const Value& value) {
+        uint64_t bits = 0;
+        switch (value.type()) {
+            case Value::Type::NUMBER: {
+                if (value.isInteger()) {
+                    int64_t integer = value.integer();
+                    std::memcpy(&bits, &integer, sizeof(bits));
+                } else {
+                    double number = value.number();
+                    std::memcpy(&bits, &number, sizeof(bits));
+                }
+                break;
+            }
+            case Value::Type::BOOLEAN:
+                bits = value.boolean();
+                break;
+            default:
+                bits = reinterpret_cast<uintptr_t>(value.object());
+                break;
+        }
+
+        auto key = std::make_tuple(value.type(), value.isInteger(), bits);
+        auto it = constantIndices.find(key);
+        if (it != constantIndices.end()) {
+            return it->second;
+        }
+        chunk().constants.push_back(value);
+        uint16_t index = checkShort(chunk().constants.size() - 1, "Too many constants in one chunk.");
+        constantIndices.emplace(key, index);
+        return index;
+    }
+
+    void emitReturn() {
+        emitConstant(makeInteger(0));
+        emit(OpCode::RETURN_VALUE);
+    }
+
+    // Reserve a 16-bit jump operand and return its offset for patchJump
+    size_t emitJumpOperand() {
+        chunk().writeShort(0xffff);
+        return chunk().code.size() - 2;
+    }
+
+    void patchJump(size_t offset) {
+        // Distance from just past the operand to the current end of the chunk
+        size_t jump = chunk().code.size() - offset - 2;
+        chunk().patchShort(offset, checkShort(jump, "Too much code to jump over."));
+    }
+
+    void emitBackJump(size_t target) {
+        size_t jump = chunk().code.size() + 2 - target;
+        chunk().writeShort(checkShort(jump, "Loop body too large."));
+    }
+
+    uint16_t nameConstant(std::string_view lexeme) {
+        std::string name(lexeme);
+        auto it = nameIndices.find(name);
+        if (it != nameIndices.end()) {
+            return it->second;
+        }
+        chunk().names.push_back(name);
+        uint16_t index = checkShort(chunk().names.size() - 1, "Too many names in one chunk.");
+        nameIndices[name] = index;
+        return index;
+    }
+
+    static uint16_t checkShort(size_t value, const char* message) {
+        if (value > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error(message);
+        }
+        return static_cast<uint16_t>(value);
+    }
+};
+
+#endif // COMPILER_H
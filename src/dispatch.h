@@ -0,0 +1,86 @@
+// dispatch.h
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "ast.h"
+#include "map.h"
+#include "runtime.h"
+
+// Pieces of CompareStmt handling shared by the Interpreter, the Compiler
+// and the Optimizer
+
+// The test a CompareStmt arm's operator stands for
+inline Comparison comparisonFor(TokenType op) {
+    switch (op) {
+        case TokenType::EQUAL_EQUAL: return Comparison::EQUAL;
+        case TokenType::BANG_EQUAL: return Comparison::NOT_EQUAL;
+        case TokenType::GREATER: return Comparison::GREATER;
+        case TokenType::GREATER_EQUAL: return Comparison::GREATER_EQUAL;
+        case TokenType::LESS: return Comparison::LESS;
+        default: return Comparison::LESS_EQUAL;
+    }
+}
+
+// Sets 'value' if 'expr' is a number, string or boolean literal
+inline bool literalValue(const ExprPtr& expr, Value& value) {
+    if (auto* number = dynamic_cast<NumberExpr*>(expr.get())) {
+        value = number->literal();
+    } else if (auto* string = dynamic_cast<StringExpr*>(expr.get())) {
+        value = makeString(string->value);
+    } else if (auto* boolean = dynamic_cast<BooleanExpr*>(expr.get())) {
+        value = makeBoolean(boolean->value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Shorter chains are as quick to test one arm at a time
+const size_t kMinDispatchArms = 4;
+
+// A chain such as 'compeq(code, 1) ... else if compeq(code, 2) ...', where
+// every arm tests the same variable for equality with a literal, can pick
+// its arm with one lookup of the variable's value instead of a test per arm.
+// Returns a map from each literal to the index of its arm, or an undefined
+// Value for any other chain. Where a literal repeats, the first arm keeps
+// it, as that is the one the tests would reach.
+//
+// Reading a variable has no side effects, so reading it once gives the
+// same result as reading it in every test.
+inline Value dispatchTable(const CompareStmt& stmt) {
+    if (stmt.arms.size() < kMinDispatchArms) {
+        return Value();
+    }
+    auto* subject = dynamic_cast<VariableExpr*>(stmt.arms[0].left.get());
+    if (subject == nullptr) {
+        return Value();
+    }
+
+    Value table = makeMap();
+    for (size_t i = 0; i < stmt.arms.size(); i++) {
+        const CompareStmt::Arm& arm = stmt.arms[i];
+        auto* variable = dynamic_cast<VariableExpr*>(arm.left.get());
+        Value literal;
+        if (arm.op != TokenType::EQUAL_EQUAL || variable == nullptr ||
+            variable->name.lexeme != subject->name.lexeme ||
+            variable->depth != subject->depth || variable->slot != subject->slot ||
+            !literalValue(arm.right, literal)) {
+            return Value();
+        }
+        if (asMap(table).find(literal) == nullptr) {
+            asMap(table).set(literal, makeNumber(static_cast<double>(i)));
+        }
+    }
+    return table;
+}
+
+// The entry of 'table' for 'value', or null if no arm matches. Only a
+// number, string or boolean can equal a literal.
+inline const Value* dispatchEntry(const Value& table, const Value& value) {
+    if (!isNumber(value) && !isString(value) && !isBoolean(value)) {
+        return nullptr;
+    }
+    return asMap(table).find(value);
+}
+
+#endif // DISPATCH_H
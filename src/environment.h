@@ -3,153 +3,135 @@
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <stdexcept>
 #include <memory>
 #include <functional>
+#include "value.h"
 
 // Forward declarations
 class FunctionStmt;
 class Interpreter;
 
-struct ValueImpl;
-using Value = std::shared_ptr<ValueImpl>;
-
-// Abstract Callable interface
-class Callable {
+// Abstract Callable interface. Functions are heap values like strings and arrays.
+class Callable : public Container {
 public:
+    // Lets the engines pick their fast call path without a dynamic_cast
+    enum class Kind : uint8_t { INTERPRETED, COMPILED, NATIVE };
+
+    const Kind kind;
+
+    explicit Callable(Kind kind) : kind(kind) {}
     virtual ~Callable() = default;
     virtual int arity() const = 0;  // Number of arguments
     virtual Value call(Interpreter* interpreter, const std::vector<Value>& arguments) = 0;
     virtual std::string toString() const = 0;
 };
 
-struct ValueImpl {
-    enum class Type { NUMBER, STRING, BOOLEAN, ARRAY, FUNCTION };
-    Type type;
-
-    double numberVal;
-    bool boolVal;
-    std::string stringVal;
-    std::vector<Value> arrayVal;
-    std::shared_ptr<Callable> callableVal;
-
-    ValueImpl(double val) : type(Type::NUMBER), numberVal(val), boolVal(false) {}
-    ValueImpl(const std::string& val) : type(Type::STRING), numberVal(0), boolVal(false), stringVal(val) {}
-    ValueImpl(bool val) : type(Type::BOOLEAN), numberVal(0), boolVal(val) {}
-    ValueImpl(const std::vector<Value>& val) : type(Type::ARRAY), numberVal(0), boolVal(false), arrayVal(val) {}
-    ValueImpl(std::shared_ptr<Callable> val) : type(Type::FUNCTION), numberVal(0), boolVal(false), callableVal(val) {}
-};
+inline Value makeFunction(Callable* val) { return Value(Value::Type::FUNCTION, val); }
 
-inline Value makeNumber(double val) { return std::make_shared<ValueImpl>(val); }
-inline Value makeString(const std::string& val) { return std::make_shared<ValueImpl>(val); }
-inline Value makeBoolean(bool val) { return std::make_shared<ValueImpl>(val); }
-inline Value makeArray(const std::vector<Value>& val) { return std::make_shared<ValueImpl>(val); }
-inline Value makeFunction(std::shared_ptr<Callable> val) { return std::make_shared<ValueImpl>(val); }
-
-inline bool isNumber(const Value& val) { return val->type == ValueImpl::Type::NUMBER; }
-inline bool isString(const Value& val) { return val->type == ValueImpl::Type::STRING; }
-inline bool isBoolean(const Value& val) { return val->type == ValueImpl::Type::BOOLEAN; }
-inline bool isArray(const Value& val) { return val->type == ValueImpl::Type::ARRAY; }
-inline bool isFunction(const Value& val) { return val->type == ValueImpl::Type::FUNCTION; }
-
-inline double asNumber(const Value& val) { 
-    if (!isNumber(val)) throw std::runtime_error("Value is not a number");
-    return val->numberVal; 
-}
-inline const std::string& asString(const Value& val) { 
-    if (!isString(val)) throw std::runtime_error("Value is not a string");
-    return val->stringVal; 
-}
-inline bool asBoolean(const Value& val) { 
-    if (!isBoolean(val)) throw std::runtime_error("Value is not a boolean");
-    return val->boolVal; 
-}
-inline std::vector<Value>& asArray(const Value& val) { 
-    if (!isArray(val)) throw std::runtime_error("Value is not an array");
-    return val->arrayVal; 
-}
-inline std::shared_ptr<Callable> asFunction(const Value& val) {
+inline Callable* asFunction(const Value& val) {
     if (!isFunction(val)) throw std::runtime_error("Value is not a function");
-    return val->callableVal;
+    return static_cast<Callable*>(val.object());
 }
 
-class Environment {
+// Variables of one function scope (or of the global scope), stored in the
+// slots assigned by the Resolver. An empty slot has not been defined yet.
+// Environments are reference counted like heap values, since functions
+// stored in them close over them.
+class Environment : public Container {
 private:
-    std::shared_ptr<Environment> enclosing;
-    std::unordered_map<std::string, Value> values;
+    Ref<Environment> enclosing;
+    std::vector<Value> slots;
     
 public:
-    Environment() : enclosing(nullptr) {}
-    
-    Environment(std::shared_ptr<Environment> enclosing) 
-        : enclosing(enclosing) {}
+    Environment() : enclosing(nullptr) {
+        Stats::environments++;
+    }
     
-    void define(const std::string& name, Value value) {
-        values[name] = value;
+    Environment(Ref<Environment> enclosing, size_t size) 
+        : enclosing(std::move(enclosing)), slots(size) {
+        Stats::environments++;
     }
 
-    Value get(const std::string& name) {
-        if (values.find(name) != values.end()) {
-            return values[name];
+    void trace(Tracer& tracer) override {
+        if (enclosing) {
+            tracer.visit(enclosing.get());
         }
-        
-        if (enclosing != nullptr) {
-            return enclosing->get(name);
+        for (const auto& value : slots) {
+            tracer.visit(value);
         }
-        
-        throw std::runtime_error("Undefined variable '" + name + "'");
-    }       
+    }
+
+    void clearReferences() override {
+        std::vector<Value> dropped;
+        dropped.swap(slots);
+        enclosing = nullptr;
+    }
 
-    bool isDefined(const std::string& name) const {
-        if (values.find(name) != values.end()) {
-            return true;
+    // Walk out 'depth' function scopes
+    Environment* ancestor(int depth) {
+        Environment* environment = this;
+        for (int i = 0; i < depth; i++) {
+            environment = environment->enclosing.get();
         }
-        
-        if (enclosing != nullptr) {
-            return enclosing->isDefined(name);
+        return environment;
+    }
+
+    // The global scope grows as new names are resolved
+    void reserve(size_t size) {
+        if (slots.size() < size) {
+            slots.resize(size);
         }
-        
-        return false;
     }
 
-    void assign(const std::string& name, Value value) {
-        if (values.find(name) != values.end()) {
-            values[name] = value;
-            return;
+    std::vector<Value>& values() {
+        return slots;
+    }
+    
+    void define(int slot, Value value) {
+        reserve(slot + 1);
+        slots[slot] = std::move(value);
+    }
+
+    Value get(int depth, int slot, std::string_view name) {
+        Environment* environment = ancestor(depth);
+        if (static_cast<size_t>(slot) < environment->slots.size() && !environment->slots[slot].isUndefined()) {
+            return environment->slots[slot];
         }
-        
-        if (enclosing != nullptr) {
-            enclosing->assign(name, value);
+        throw std::runtime_error("Undefined variable '" + std::string(name) + "'");
+    }
+
+    void assign(int depth, int slot, std::string_view name, Value value) {
+        Environment* environment = ancestor(depth);
+        if (static_cast<size_t>(slot) < environment->slots.size() && !environment->slots[slot].isUndefined()) {
+            environment->slots[slot] = std::move(value);
             return;
         }
-        
-        throw std::runtime_error("Undefined variable '" + name + "'");
+        throw std::runtime_error("Undefined variable '" + std::string(name) + "'");
     }
 };
 
-// Return exception for unwinding the call stack
-class Return : public std::runtime_error {
-private:
-    Value value;
-    
-public:
-    Return(Value value) : std::runtime_error(""), value(value) {}
-    
-    Value getValue() const { return value; }
-};
-
 // AxScript Function implementation
 class AxScriptFunction : public Callable {
 private:
     FunctionStmt* declaration;
-    std::shared_ptr<Environment> closure;
+    Ref<Environment> closure;
     
 public:
-    AxScriptFunction(FunctionStmt* declaration, std::shared_ptr<Environment> closure)
-        : declaration(declaration), closure(closure) {}
+    AxScriptFunction(FunctionStmt* declaration, Ref<Environment> closure)
+        : Callable(Kind::INTERPRETED), declaration(declaration), closure(std::move(closure)) {}
     
+    void trace(Tracer& tracer) override {
+        tracer.visit(closure.get());
+    }
+
+    void clearReferences() override {
+        closure = nullptr;
+    }
+
     int arity() const override;
     Value call(Interpreter* interpreter, const std::vector<Value>& arguments) override;
     std::string toString() const override;
@@ -1,4 +1,5 @@
 #include "environment.h"
+#include "gc.h"
 #include "ast.h"
 #include "interpreter.h"
 
@@ -7,26 +8,27 @@ int AxScriptFunction::arity() const {
 }
 
 Value AxScriptFunction::call(Interpreter* interpreter, const std::vector<Value>& arguments) {
+    Stats::calls++;
+    Profiler::Call frame(declaration->name.lexeme);
+
+    // Calls are where new environments, and so new cycles, appear
+    CycleCollector::maybeCollect();
+
     // Create a new environment for the function, with the closure as its enclosing scope
-    auto environment = std::make_shared<Environment>(closure);
+    auto environment = makeRef<Environment>(closure, declaration->localNames.size());
     
-    // Bind arguments to parameters
+    // Bind arguments to parameters, which occupy the first slots
     for (size_t i = 0; i < declaration->parameters.size(); i++) {
-        environment->define(declaration->parameters[i].lexeme, arguments[i]);
+        environment->define(static_cast<int>(i), arguments[i]);
     }
     
-    try {
-        // Execute the function body in the new environment
-        interpreter->executeBlock(declaration->body, environment);
-    } catch (const Return& returnValue) {
-        // Catch return statements and pass the value back up
-        return returnValue.getValue();
-    }
+    // Execute the function body in the new environment
+    interpreter->executeBlock(declaration->body, environment);
     
-    // If no return statement was encountered, return nil
-    return makeNumber(0); // Default return value
+    // Pass the returned value, or the default 0, back up
+    return interpreter->takeReturnValue();
 }
 
 std::string AxScriptFunction::toString() const {
-    return "<function " + declaration->name.lexeme + ">";
+    return "<function " + std::string(declaration->name.lexeme) + ">";
 }
\ No newline at end of file
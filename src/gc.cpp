@@ -0,0 +1,78 @@
+// gc.cpp
+
+#include "gc.h"
+#include <vector>
+
+size_t CycleCollector::threshold = 10000;
+size_t CycleCollector::survivors = 0;
+
+namespace {
+
+// Removes one count for each reference held by another Container
+class SubtractInternal : public Tracer {
+public:
+    void visit(Container* container) override {
+        container->gcRefs--;
+    }
+};
+
+// Spreads reachability from the roots; reachable Containers get gcRefs -1
+class MarkReachable : public Tracer {
+public:
+    std::vector<Container*> pending;
+
+    void visit(Container* container) override {
+        if (container->gcRefs != -1) {
+            container->gcRefs = -1;
+            pending.push_back(container);
+        }
+    }
+};
+
+} // namespace
+
+size_t CycleCollector::collect() {
+    Stats::collections++;
+    Container::allocations = 0;
+
+    for (Container* c = Container::head; c != nullptr; c = c->gcNext) {
+        c->gcRefs = c->refCount;
+    }
+
+    SubtractInternal subtract;
+    for (Container* c = Container::head; c != nullptr; c = c->gcNext) {
+        c->trace(subtract);
+    }
+
+    // Whatever still has a count left is referenced from outside the heap
+    MarkReachable mark;
+    for (Container* c = Container::head; c != nullptr; c = c->gcNext) {
+        if (c->gcRefs > 0) {
+            mark.visit(c);
+        }
+    }
+    while (!mark.pending.empty()) {
+        Container* c = mark.pending.back();
+        mark.pending.pop_back();
+        c->trace(mark);
+    }
+
+    // Hold the garbage while clearing it, so no object is freed while
+    // another one in the cycle still points at it
+    std::vector<Container*> garbage;
+    for (Container* c = Container::head; c != nullptr; c = c->gcNext) {
+        if (c->gcRefs != -1) {
+            retainObj(c);
+            garbage.push_back(c);
+        }
+    }
+    for (Container* c : garbage) {
+        c->clearReferences();
+    }
+    for (Container* c : garbage) {
+        releaseObj(c);
+    }
+
+    survivors = Container::liveCount;
+    return garbage.size();
+}
@@ -0,0 +1,39 @@
+// gc.h
+#ifndef GC_H
+#define GC_H
+
+#include "value.h"
+#include <cstddef>
+
+// Frees cycles of Containers that reference counting cannot, such as a
+// function stored in the environment it closes over.
+//
+// A collection works out, for every live Container, how many of its
+// references come from other Containers. Anything referenced from elsewhere
+// (a Value on the VM stack, a local in the interpreter, a running call's
+// environment) is a root, so no root set has to be registered. Containers not
+// reachable from a root are garbage: their references are cleared, which lets
+// reference counting free them.
+class CycleCollector
+{
+public:
+    // Collect once this many Containers have been allocated since the last
+    // collection, or as many as survived it if that is larger. 0 turns
+    // automatic collection off.
+    static size_t threshold;
+
+    // Returns the number of Containers freed
+    static size_t collect();
+
+    // Call only where every live object is held by a counted reference
+    static void maybeCollect() {
+        if (threshold != 0 && Container::allocations >= threshold && Container::allocations >= survivors) {
+            collect();
+        }
+    }
+
+private:
+    static size_t survivors;  // Live Containers after the last collection
+};
+
+#endif // GC_H
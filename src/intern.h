@@ -0,0 +1,40 @@
+// intern.h
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "value.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Every string literal and identifier of the program, stored once. The
+// handles are ObjStrings marked as interned that live until the process
+// exits, so two interned strings are equal exactly when they are the same
+// object, and a literal evaluates to a shared string instead of a new one.
+class StringTable
+{
+public:
+    static ObjString* intern(std::string_view text) {
+        auto& strings = table();
+        auto it = strings.find(text);
+        if (it != strings.end()) {
+            return it->second.get();
+        }
+
+        Ref<ObjString> string = makeRef<ObjString>(std::string(text));
+        string->interned = true;
+        ObjString* handle = string.get();
+
+        // The key views the string's own text, which never changes
+        strings.emplace(std::string_view(handle->str()), std::move(string));
+        return handle;
+    }
+
+private:
+    static std::unordered_map<std::string_view, Ref<ObjString>>& table() {
+        static std::unordered_map<std::string_view, Ref<ObjString>> strings;
+        return strings;
+    }
+};
+
+#endif // INTERN_H
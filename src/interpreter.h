@@ -5,6 +5,10 @@
 #include "visitor.h"
 #include "ast.h"
 #include "environment.h"
+#include "runtime.h"
+#include "dispatch.h"
+#include "builtins.h"
+#include "profiler.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -16,22 +20,27 @@ private:
     Value result;
     bool breakEncountered = false;
     bool continueEncountered = false;
+    bool returnEncountered = false; // Set by a return statement until the call consumes it
+    Value returnValue;
     bool inLoop = false; // Track whether we're inside a loop for break/continue validation
 
 private:
-    void execute(const std::unique_ptr<Stmt>& stmt) {
+    void execute(const StmtPtr& stmt) {
         if (stmt) {
+            if (Profiler::enabled) {
+                Profiler::at(stmt->line);
+            }
             stmt->accept(this);
         }
     }
 
 public:
-    std::shared_ptr<Environment> environment = std::make_shared<Environment>();
+    Ref<Environment> environment = makeRef<Environment>();
     
-    void executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements, 
-                     std::shared_ptr<Environment> environment) {
+    void executeBlock(const std::vector<StmtPtr>& statements, 
+                     Ref<Environment> environment) {
         // Save the current environment
-        std::shared_ptr<Environment> previousEnvironment = this->environment;
+        Ref<Environment> previousEnvironment = this->environment;
         
         try {
             // Set the environment to the new one for the block
@@ -40,7 +49,7 @@ public:
             // Execute all statements in the block
             for (const auto& statement : statements) {
                 execute(statement);
-                if (breakEncountered || continueEncountered) {
+                if (breakEncountered || continueEncountered || returnEncountered) {
                     break;
                 }
             }
@@ -56,7 +65,11 @@ public:
 
     void visit(NumberExpr *expr) override
     {
-        result = makeNumber(expr->value);
+        if (expr->integer) {
+            result = makeInteger(expr->integerValue);
+        } else {
+            result = makeNumber(expr->value);
+        }
     }
 
     void visit(StringExpr *expr) override
@@ -71,51 +84,39 @@ public:
 
     void visit(VariableExpr *expr) override
     {
-        if (environment->isDefined(expr->name.lexeme))
-        {
-            result = environment->get(expr->name.lexeme);
-        }
-        else
-        {
-            throw std::runtime_error("Undefined variable '" + expr->name.lexeme + "'");
-        }
+        result = environment->get(expr->depth, expr->slot, expr->name.lexeme);
     }
 
     void visit(BinaryExpr *expr) override
     {
         expr->left->accept(this);
-        auto leftValue = result;
+        auto leftValue = std::move(result);
         expr->right->accept(this);
-        auto rightValue = result;
+        auto rightValue = std::move(result);
 
         switch (expr->op.type)
         {
         case TokenType::PLUS:
             if (isString(leftValue) || isString(rightValue)) {
                 // String concatenation - convert both operands to string
-                std::string leftStr = valueToString(leftValue);
-                std::string rightStr = valueToString(rightValue);
-                result = makeString(leftStr + rightStr);
+                result = concatenate(leftValue, rightValue);
             } else if (isNumber(leftValue) && isNumber(rightValue)) {
                 // Numeric addition
-                result = makeNumber(asNumber(leftValue) + asNumber(rightValue));
+                result = addNumbers(leftValue, rightValue);
             } else if (isArray(leftValue) && isArray(rightValue)) {
                 // Array concatenation
-                auto resultArray = asArray(leftValue);
-                const auto& rightArray = asArray(rightValue);
-                resultArray.insert(resultArray.end(), rightArray.begin(), rightArray.end());
-                result = makeArray(resultArray);
+                result = concatenateArrays(asArray(leftValue), asArray(rightValue));
             } else {
                 throw std::runtime_error("Operands must be two numbers, two arrays, or at least one string.");
             }
             break;
         case TokenType::MINUS:
             checkNumberOperands(expr->op, leftValue, rightValue);
-            result = makeNumber(asNumber(leftValue) - asNumber(rightValue));
+            result = subtractNumbers(leftValue, rightValue);
             break;
         case TokenType::STAR:
             checkNumberOperands(expr->op, leftValue, rightValue);
-            result = makeNumber(asNumber(leftValue) * asNumber(rightValue));
+            result = multiplyNumbers(leftValue, rightValue);
             break;
         case TokenType::SLASH:
             checkNumberOperands(expr->op, leftValue, rightValue);
@@ -129,43 +130,19 @@ public:
             if (asNumber(rightValue) == 0) {
                 throw std::runtime_error("Error: Modulo by zero");
             }
-            result = makeNumber(std::fmod(asNumber(leftValue), asNumber(rightValue)));
+            result = moduloNumbers(leftValue, rightValue);
             break;
         case TokenType::GREATER:
-            if (isNumber(leftValue) && isNumber(rightValue)) {
-                result = makeBoolean(asNumber(leftValue) > asNumber(rightValue));
-            } else if (isString(leftValue) && isString(rightValue)) {
-                result = makeBoolean(asString(leftValue) > asString(rightValue));
-            } else {
-                throw std::runtime_error("Operands must be two numbers or two strings.");
-            }
+            result = makeBoolean(compareValues(Comparison::GREATER, leftValue, rightValue));
             break;
         case TokenType::GREATER_EQUAL:
-            if (isNumber(leftValue) && isNumber(rightValue)) {
-                result = makeBoolean(asNumber(leftValue) >= asNumber(rightValue));
-            } else if (isString(leftValue) && isString(rightValue)) {
-                result = makeBoolean(asString(leftValue) >= asString(rightValue));
-            } else {
-                throw std::runtime_error("Operands must be two numbers or two strings.");
-            }
+            result = makeBoolean(compareValues(Comparison::GREATER_EQUAL, leftValue, rightValue));
             break;
         case TokenType::LESS:
-            if (isNumber(leftValue) && isNumber(rightValue)) {
-                result = makeBoolean(asNumber(leftValue) < asNumber(rightValue));
-            } else if (isString(leftValue) && isString(rightValue)) {
-                result = makeBoolean(asString(leftValue) < asString(rightValue));
-            } else {
-                throw std::runtime_error("Operands must be two numbers or two strings.");
-            }
+            result = makeBoolean(compareValues(Comparison::LESS, leftValue, rightValue));
             break;
         case TokenType::LESS_EQUAL:
-            if (isNumber(leftValue) && isNumber(rightValue)) {
-                result = makeBoolean(asNumber(leftValue) <= asNumber(rightValue));
-            } else if (isString(leftValue) && isString(rightValue)) {
-                result = makeBoolean(asString(leftValue) <= asString(rightValue));
-            } else {
-                throw std::runtime_error("Operands must be two numbers or two strings.");
-            }
+            result = makeBoolean(compareValues(Comparison::LESS_EQUAL, leftValue, rightValue));
             break;
         case TokenType::EQUAL_EQUAL:
             result = makeBoolean(isEqual(leftValue, rightValue));
@@ -184,7 +161,7 @@ public:
         // Populate array with elements
         for (const auto& element : expr->elements) {
             element->accept(this);
-            array.push_back(result);
+            array.push_back(std::move(result));
         }
         
         // Check if we need to pad the array to match the specified size
@@ -198,90 +175,65 @@ public:
             array.resize(expr->size);
         }
         
-        result = makeArray(array);
+        result = makeArray(std::move(array));
     }
 
     void visit(ArrayExpr* expr) override {
         std::vector<Value> array;
         for (const auto& element : expr->elements) {
             element->accept(this);
-            array.push_back(result);
+            array.push_back(std::move(result));
+        }
+        result = makeArray(std::move(array));
+    }
+
+    void visit(MapExpr* expr) override {
+        Value map = makeMap();
+        for (size_t i = 0; i < expr->keys.size(); i++) {
+            expr->keys[i]->accept(this);
+            Value key = std::move(result);
+            expr->values[i]->accept(this);
+            asMap(map).set(key, std::move(result));
         }
-        result = makeArray(array);
+        result = std::move(map);
     }
 
     void visit(IndexExpr* expr) override {
         // Evaluate the object being indexed
         expr->object->accept(this);
-        auto object = result;
+        auto object = std::move(result);
         
         // Evaluate the index
         expr->index->accept(this);
-        auto index = result;
+        auto index = std::move(result);
         
-        // Make sure we're indexing an array
-        if (!isArray(object)) {
-            throw std::runtime_error("Cannot index a non-array value");
-        }
-        
-        // Make sure the index is a number
-        if (!isNumber(index)) {
-            throw std::runtime_error("Array index must be a number");
-        }
-        
-        auto& array = asArray(object);
-        int idx = static_cast<int>(asNumber(index));
-        
-        // Check bounds
-        if (idx < 0 || idx >= static_cast<int>(array.size())) {
-            throw std::runtime_error("Array index out of bounds: " + std::to_string(idx));
-        }
-        
-        // Return the element at the index
-        result = array[idx];
+        // Return the element at the index, or the value for the key
+        result = indexValue(object, index);
     }
 
     void visit(AssignIndexExpr* expr) override {
         // Evaluate the object being indexed
         expr->object->accept(this);
-        auto object = result;
+        auto object = std::move(result);
         
         // Evaluate the index
         expr->index->accept(this);
-        auto index = result;
+        auto index = std::move(result);
         
         // Evaluate the value to assign
         expr->value->accept(this);
-        auto value = result;
-        
-        // Make sure we're indexing an array
-        if (!isArray(object)) {
-            throw std::runtime_error("Cannot index a non-array value");
-        }
+        auto value = std::move(result);
         
-        // Make sure the index is a number
-        if (!isNumber(index)) {
-            throw std::runtime_error("Array index must be a number");
-        }
-        
-        auto& array = asArray(object);
-        int idx = static_cast<int>(asNumber(index));
-        
-        // Check bounds
-        if (idx < 0 || idx >= static_cast<int>(array.size())) {
-            throw std::runtime_error("Array index out of bounds: " + std::to_string(idx));
-        }
-        
-        // Assign the value to the array element
-        array[idx] = value;
+        // Assign the value to the array element or map key
+        assignIndex(object, index, value);
         
         // Return the assigned value
-        result = value;
+        result = std::move(value);
     }
 
     void visit(BlockStmt* stmt) override {
         for (const auto& statement : stmt->statements) {
-            if (breakEncountered || continueEncountered) {
+            if (breakEncountered || continueEncountered || returnEncountered) {
                 break;
             }
             execute(statement);
@@ -294,35 +246,49 @@ public:
         
         // Evaluate the from expression
         stmt->from->accept(this);
-        double fromValue = asNumber(result);
+        asNumber(result);
+        Value fromValue = std::move(result);
         
         // Evaluate the to expression
         stmt->to->accept(this);
-        double toValue = asNumber(result);
+        asNumber(result);
+        Value toValue = std::move(result);
         
         // Evaluate the step expression if it exists
-        double stepValue = 1.0;
+        Value stepValue = makeInteger(1);
         if (stmt->step) {
             stmt->step->accept(this);
-            stepValue = asNumber(result);
+            asNumber(result);
+            stepValue = std::move(result);
         }
         
         bool isDownLoop = stmt->isDownward;
         
-        // Set the loop variable
-        environment->define(stmt->var.lexeme, makeNumber(fromValue));
+        // Count in a local; assignments to the loop variable inside the body
+        // never affected the next iteration anyway. Integer operands keep
+        // an integer counter.
+        Value currentValue = fromValue;
         
         // Execute the loop
         while (true) {
+            // Expose the counter to the body, and leave the final value behind
+            if (stmt->varUsed) {
+                environment->define(stmt->slot, currentValue);
+            }
+            
             // Check the loop condition
-            double currentValue = asNumber(environment->get(stmt->var.lexeme));
-            if ((isDownLoop && currentValue < toValue) || (!isDownLoop && currentValue > toValue)) {
+            if (loopFinished(isDownLoop, currentValue, toValue)) {
                 break;
             }
             
             // Execute the body
             execute(stmt->body);
             
+            // A return leaves the loop and the function
+            if (returnEncountered) {
+                break;
+            }
+            
             // Handle break
             if (breakEncountered) {
                 breakEncountered = false;
@@ -333,8 +299,7 @@ public:
             continueEncountered = false;
             
             // Update the loop variable
-            double newValue = currentValue + (isDownLoop ? -stepValue : stepValue);
-            environment->assign(stmt->var.lexeme, makeNumber(newValue));
+            currentValue = isDownLoop ? subtractNumbers(currentValue, stepValue) : addNumbers(currentValue, stepValue);
         }
         
         inLoop = oldInLoop;
@@ -358,128 +323,32 @@ public:
         stmt->expression->accept(this);
     }
     
-    void visit(CompEqStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        result = makeBoolean(isEqual(leftValue, rightValue));
-        
-        if (isTruthy(result)) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
-            execute(stmt->elseBranch);
-        }
-    }
-    
-    void visit(CompNeqStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        result = makeBoolean(!isEqual(leftValue, rightValue));
-        
-        if (isTruthy(result)) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
-            execute(stmt->elseBranch);
-        }
-    }
-    
-    void visit(CompGeStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        bool compResult = false;
-        if (isNumber(leftValue) && isNumber(rightValue)) {
-            compResult = asNumber(leftValue) >= asNumber(rightValue);
-        } else if (isString(leftValue) && isString(rightValue)) {
-            compResult = asString(leftValue) >= asString(rightValue);
-        } else {
-            throw std::runtime_error("Operands must be two numbers or two strings.");
-        }
-        
-        result = makeBoolean(compResult);
-        
-        if (compResult) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
-            execute(stmt->elseBranch);
-        }
-    }
-    
-    void visit(CompLeStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        bool compResult = false;
-        if (isNumber(leftValue) && isNumber(rightValue)) {
-            compResult = asNumber(leftValue) <= asNumber(rightValue);
-        } else if (isString(leftValue) && isString(rightValue)) {
-            compResult = asString(leftValue) <= asString(rightValue);
-        } else {
-            throw std::runtime_error("Operands must be two numbers or two strings.");
-        }
-        
-        result = makeBoolean(compResult);
-        
-        if (compResult) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
-            execute(stmt->elseBranch);
+    void visit(CompareStmt* stmt) override {
+        if (!stmt->dispatchChecked) {
+            stmt->dispatch = dispatchTable(*stmt);
+            stmt->dispatchChecked = true;
+        }
+        if (!stmt->dispatch.isUndefined()) {
+            stmt->arms[0].left->accept(this);
+            if (const Value* arm = dispatchEntry(stmt->dispatch, result)) {
+                execute(stmt->arms[static_cast<size_t>(asNumber(*arm))].body);
+            } else if (stmt->elseBranch) {
+                execute(stmt->elseBranch);
+            }
+            return;
         }
-    }
-    
-    void visit(CompGStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        bool compResult = false;
-        if (isNumber(leftValue) && isNumber(rightValue)) {
-            compResult = asNumber(leftValue) > asNumber(rightValue);
-        } else if (isString(leftValue) && isString(rightValue)) {
-            compResult = asString(leftValue) > asString(rightValue);
-        } else {
-            throw std::runtime_error("Operands must be two numbers or two strings.");
+
+        // The tests decide the branch directly instead of going through a boolean result
+        for (const auto& arm : stmt->arms) {
+            arm.left->accept(this);
+            Value leftValue = std::move(result);
+            arm.right->accept(this);
+            if (compareValues(comparisonFor(arm.op), leftValue, result)) {
+                execute(arm.body);
+                return;
+            }
         }
-        
-        result = makeBoolean(compResult);
-        
-        if (compResult) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
-            execute(stmt->elseBranch);
-        }
-    }
-    
-    void visit(CompLStmt* stmt) override {
-        stmt->left->accept(this);
-        auto leftValue = result;
-        stmt->right->accept(this);
-        auto rightValue = result;
-        
-        bool compResult = false;
-        if (isNumber(leftValue) && isNumber(rightValue)) {
-            compResult = asNumber(leftValue) < asNumber(rightValue);
-        } else if (isString(leftValue) && isString(rightValue)) {
-            compResult = asString(leftValue) < asString(rightValue);
-        } else {
-            throw std::runtime_error("Operands must be two numbers or two strings.");
-        }
-        
-        result = makeBoolean(compResult);
-        
-        if (compResult) {
-            execute(stmt->thenBranch);
-        } else if (stmt->elseBranch) {
+        if (stmt->elseBranch) {
             execute(stmt->elseBranch);
         }
     }
@@ -584,92 +453,20 @@ public:
     
     void visit(CompEqExpr* expr) override {
         expr->left->accept(this);
-        auto leftValue = result;
+        auto leftValue = std::move(result);
         expr->right->accept(this);
-        auto rightValue = result;
+        auto rightValue = std::move(result);
         
         result = makeBoolean(isEqual(leftValue, rightValue));
     }
 
-    // Helper for converting any value to a string
-    std::string valueToString(const Value& value) {
-        if (isString(value)) {
-            return asString(value);
-        } else if (isNumber(value)) {
-            double num = asNumber(value);
-            if (num == static_cast<int>(num)) {
-                // It's a whole number, remove decimal part
-                return std::to_string(static_cast<int>(num));
-            } else {
-                // Format with precision to avoid trailing zeros
-                std::ostringstream ss;
-                ss << std::fixed << std::setprecision(15) << num;
-                std::string str = ss.str();
-                // Remove trailing zeros
-                str = str.substr(0, str.find_last_not_of('0') + 1);
-                // Remove trailing decimal point if needed
-                if (str.back() == '.') str.pop_back();
-                return str;
-            }
-        } else if (isBoolean(value)) {
-            return asBoolean(value) ? "true" : "false";
-        } else if (isArray(value)) {
-            // Create string representation of array
-            std::string result = "[";
-            const auto& array = asArray(value);
-            for (size_t i = 0; i < array.size(); i++) {
-                result += valueToString(array[i]);
-                if (i < array.size() - 1) {
-                    result += ", ";
-                }
-            }
-            result += "]";
-            return result;
-        }
-        return "nil";
-    }
-
-    // Helper for boolean equality comparison
-    bool isEqual(const Value& a, const Value& b) {
-        // Check if they're the same object
-        if (a == b) return true;
-        
-        // Different types are never equal
-        if (a->type != b->type) return false;
-        
-        // Same type comparison
-        switch (a->type) {
-            case ValueImpl::Type::NUMBER:
-                return asNumber(a) == asNumber(b);
-            case ValueImpl::Type::STRING:
-                return asString(a) == asString(b);
-            case ValueImpl::Type::BOOLEAN:
-                return asBoolean(a) == asBoolean(b);
-            case ValueImpl::Type::ARRAY: {
-                const auto& arrayA = asArray(a);
-                const auto& arrayB = asArray(b);
-                
-                // Different lengths means different arrays
-                if (arrayA.size() != arrayB.size()) return false;
-                
-                // Compare each element
-                for (size_t i = 0; i < arrayA.size(); i++) {
-                    if (!isEqual(arrayA[i], arrayB[i])) return false;
-                }
-                return true;
-            }
-            default:
-                return false;
-        }
-    }
-
     // Helper to check number operands
     void checkNumberOperands(const Token& op, 
                             const Value& left,
                             const Value& right) {
         if (isNumber(left) && isNumber(right)) return;
         throw std::runtime_error(std::string("Operands must be numbers for operator '") + 
-                                op.lexeme + "'.");
+                                std::string(op.lexeme) + "'.");
     }
 
     void visit(PrintStmt *stmt) override
@@ -685,150 +482,60 @@ public:
         if (stmt->initializer != nullptr)
         {
             stmt->initializer->accept(this);
-            value = result;
+            value = std::move(result);
         }
         else
         {
-            value = makeNumber(0.0);
+            value = makeInteger(0);
         }
-        environment->define(stmt->name.lexeme, value);
+        environment->define(stmt->slot, value);
     }
 
     void visit(InputStmt *stmt) override
     {
-        std::string input;
-        std::getline(std::cin, input);
-        
-        // Try to convert to number, but handle errors properly
-        try {
-            size_t pos;
-            double value = std::stod(input, &pos);
-            
-            // Check if the entire string was converted
-            if (pos == input.length()) {
-                environment->define(stmt->variableName.lexeme, makeNumber(value));
-            } else {
-                // Check for boolean values
-                if (input == "true") {
-                    environment->define(stmt->variableName.lexeme, makeBoolean(true));
-                } else if (input == "false") {
-                    environment->define(stmt->variableName.lexeme, makeBoolean(false));
-                } else if (input.front() == '[' && input.back() == ']') {
-                    // Basic array parsing for input (simple format)
-                    std::vector<Value> array;
-                    // Parse a simple comma-separated list of values
-                    std::string contents = input.substr(1, input.length() - 2);
-                    std::istringstream ss(contents);
-                    std::string item;
-                    
-                    while (std::getline(ss, item, ',')) {
-                        // Trim spaces
-                        item.erase(0, item.find_first_not_of(" \t"));
-                        item.erase(item.find_last_not_of(" \t") + 1);
-                        
-                        // Try to parse as number, boolean, or string
-                        if (item == "true") {
-                            array.push_back(makeBoolean(true));
-                        } else if (item == "false") {
-                            array.push_back(makeBoolean(false));
-                        } else {
-                            try {
-                                size_t pos;
-                                double num = std::stod(item, &pos);
-                                if (pos == item.length()) {
-                                    array.push_back(makeNumber(num));
-                                } else {
-                                    array.push_back(makeString(item));
-                                }
-                            } catch (const std::exception&) {
-                                array.push_back(makeString(item));
-                            }
-                        }
-                    }
-                    
-                    environment->define(stmt->variableName.lexeme, makeArray(array));
-                } else {
-                    environment->define(stmt->variableName.lexeme, makeString(input));
-                }
-            }
-        }
-        catch (const std::invalid_argument&) {
-            // Check for boolean values
-            if (input == "true") {
-                environment->define(stmt->variableName.lexeme, makeBoolean(true));
-            } else if (input == "false") {
-                environment->define(stmt->variableName.lexeme, makeBoolean(false));
-            } else if (input.front() == '[' && input.back() == ']') {
-                // Basic array parsing
-                std::vector<Value> array;
-                // Very simple parsing - split by commas
-                std::string contents = input.substr(1, input.length() - 2);
-                std::istringstream ss(contents);
-                std::string item;
-                
-                while (std::getline(ss, item, ',')) {
-                    // Trim spaces
-                    item.erase(0, item.find_first_not_of(" \t"));
-                    item.erase(item.find_last_not_of(" \t") + 1);
-                    
-                    // Just store everything as strings in this basic version
-                    array.push_back(makeString(item));
-                }
-                
-                environment->define(stmt->variableName.lexeme, makeArray(array));
-            } else {
-                // Not a number or boolean, treat as string
-                environment->define(stmt->variableName.lexeme, makeString(input));
-            }
-        }
-        catch (const std::out_of_range&) {
-            // Number out of range
-            std::cerr << "Warning: Number out of range, treating as string" << std::endl;
-            environment->define(stmt->variableName.lexeme, makeString(input));
-        }
-    }
-    
-    // Helper to check if a value is truthy
-    bool isTruthy(const Value& value) {
-        if (isBoolean(value)) { // boolean
-            return asBoolean(value);
-        } else if (isNumber(value)) { // number
-            return asNumber(value) != 0.0;
-        } else if (isString(value)) { // string
-            return !asString(value).empty();
-        } else if (isArray(value)) { // array
-            return !asArray(value).empty();
-        }
-        return false;
+        environment->define(stmt->slot, readInputValue());
     }
 
     void visit(AssignExpr* expr) override {
         expr->value->accept(this);
-        environment->assign(expr->name.lexeme, result);
+        environment->assign(expr->depth, expr->slot, expr->name.lexeme, result);
     }
 
     // Function declaration visitor
     void visit(FunctionStmt* stmt) override {
-        auto function = std::make_shared<AxScriptFunction>(stmt, environment);
-        auto value = makeFunction(function);
-        environment->define(stmt->name.lexeme, value);
+        auto value = makeFunction(new AxScriptFunction(stmt, environment));
+        environment->define(stmt->slot, value);
     }
 
     // Function call visitor
     void visit(CallExpr* expr) override {
         // Evaluate the callee (should be a function)
         expr->callee->accept(this);
-        auto callee = result;
+        auto callee = std::move(result);
         
         if (!isFunction(callee)) {
             throw std::runtime_error("Can only call functions.");
         }
         
+        // Natives take their arguments from a fixed array, no vector needed
+        Callable* callable = asFunction(callee);
+        if (callable->kind == Callable::Kind::NATIVE
+                && expr->arguments.size() == static_cast<size_t>(callable->arity())
+                && callable->arity() <= NativeFunction::kMaxArity) {
+            Value arguments[NativeFunction::kMaxArity];
+            for (size_t i = 0; i < expr->arguments.size(); i++) {
+                expr->arguments[i]->accept(this);
+                arguments[i] = std::move(result);
+            }
+            result = static_cast<NativeFunction*>(callable)->invoke(arguments);
+            return;
+        }
+        
         // Evaluate all arguments
         std::vector<Value> arguments;
         for (const auto& arg : expr->arguments) {
             arg->accept(this);
-            arguments.push_back(result);
+            arguments.push_back(std::move(result));
         }
         
         auto function = asFunction(callee);
@@ -847,29 +554,47 @@ public:
 
     // Return statement visitor
     void visit(ReturnStmt* stmt) override {
-        Value value = makeNumber(0); // Default return value
+        Value value = makeInteger(0); // Default return value
         
         if (stmt->value != nullptr) {
             stmt->value->accept(this);
-            value = result;
+            value = std::move(result);
         }
         
-        // Throw special exception to unwind the call stack
-        throw Return(value);
+        // Unwind to the caller through the same flags as break and continue
+        returnValue = std::move(value);
+        returnEncountered = true;
     }
 
-    void interpret(const std::vector<std::unique_ptr<Stmt>> &statements)
+    // Hands the value of the last return statement to the function call that
+    // executed it; functions that fall off the end return 0
+    Value takeReturnValue() {
+        if (!returnEncountered) {
+            return makeInteger(0);
+        }
+        returnEncountered = false;
+        return std::move(returnValue);
+    }
+
+    void interpret(const std::vector<StmtPtr> &statements)
     {
         try
         {
             breakEncountered = false;
             continueEncountered = false;
+            returnEncountered = false;
             for (const auto &stmt : statements)
             {
                 if (stmt)
                 {
                     execute(stmt);
                     continueEncountered = false;
+                    // A top-level return ends the script
+                    if (returnEncountered)
+                    {
+                        returnEncountered = false;
+                        break;
+                    }
                 }
             }
         }
@@ -0,0 +1,330 @@
+// kernels.cpp
+
+#include "kernels.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define AX_X86 1
+#endif
+
+namespace {
+
+// min and max pick the way the SIMD instructions do: the second operand
+// unless the first compares smaller (larger), so every path treats NaN alike
+inline double pickMin(double a, double b) {
+    return a < b ? a : b;
+}
+
+inline double pickMax(double a, double b) {
+    return a > b ? a : b;
+}
+
+#ifdef AX_X86
+
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// AVX2: four doubles per register, two registers per iteration
+
+__attribute__((target("avx2")))
+double sumAvx2(const double* values, size_t count) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(values + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < count; i++) {
+        total += values[i];
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+double dotAvx2(const double* a, const double* b, size_t count) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < count; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+double minAvx2(const double* values, size_t count) {
+    size_t i = 0;
+    double result = values[0];
+    if (count >= 4) {
+        __m256d acc = _mm256_loadu_pd(values);
+        for (i = 4; i + 4 <= count; i += 4) {
+            acc = _mm256_min_pd(acc, _mm256_loadu_pd(values + i));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        result = pickMin(pickMin(lanes[0], lanes[1]), pickMin(lanes[2], lanes[3]));
+    }
+    for (; i < count; i++) {
+        result = pickMin(result, values[i]);
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+double maxAvx2(const double* values, size_t count) {
+    size_t i = 0;
+    double result = values[0];
+    if (count >= 4) {
+        __m256d acc = _mm256_loadu_pd(values);
+        for (i = 4; i + 4 <= count; i += 4) {
+            acc = _mm256_max_pd(acc, _mm256_loadu_pd(values + i));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        result = pickMax(pickMax(lanes[0], lanes[1]), pickMax(lanes[2], lanes[3]));
+    }
+    for (; i < count; i++) {
+        result = pickMax(result, values[i]);
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+void scaleAvx2(const double* values, double factor, double* out, size_t count) {
+    __m256d factors = _mm256_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(values + i), factors));
+    }
+    for (; i < count; i++) {
+        out[i] = values[i] * factor;
+    }
+}
+
+__attribute__((target("avx2")))
+void addAvx2(const double* a, const double* b, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    for (; i < count; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+__attribute__((target("avx2")))
+void mulAvx2(const double* a, const double* b, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    for (; i < count; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+// SSE2, which every x86-64 CPU has: two doubles per register
+
+double sumSse2(const double* values, size_t count) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double total = lanes[0] + lanes[1];
+    for (; i < count; i++) {
+        total += values[i];
+    }
+    return total;
+}
+
+double dotSse2(const double* a, const double* b, size_t count) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double total = lanes[0] + lanes[1];
+    for (; i < count; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+double minSse2(const double* values, size_t count) {
+    size_t i = 0;
+    double result = values[0];
+    if (count >= 2) {
+        __m128d acc = _mm_loadu_pd(values);
+        for (i = 2; i + 2 <= count; i += 2) {
+            acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        result = pickMin(lanes[0], lanes[1]);
+    }
+    for (; i < count; i++) {
+        result = pickMin(result, values[i]);
+    }
+    return result;
+}
+
+double maxSse2(const double* values, size_t count) {
+    size_t i = 0;
+    double result = values[0];
+    if (count >= 2) {
+        __m128d acc = _mm_loadu_pd(values);
+        for (i = 2; i + 2 <= count; i += 2) {
+            acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        result = pickMax(lanes[0], lanes[1]);
+    }
+    for (; i < count; i++) {
+        result = pickMax(result, values[i]);
+    }
+    return result;
+}
+
+void scaleSse2(const double* values, double factor, double* out, size_t count) {
+    __m128d factors = _mm_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(values + i), factors));
+    }
+    for (; i < count; i++) {
+        out[i] = values[i] * factor;
+    }
+}
+
+void addSse2(const double* a, const double* b, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    for (; i < count; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+void mulSse2(const double* a, const double* b, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    for (; i < count; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+#endif // AX_X86
+
+} // namespace
+
+#ifdef AX_X86
+
+double ArrayKernels::sum(const double* values, size_t count) {
+    return hasAvx2() ? sumAvx2(values, count) : sumSse2(values, count);
+}
+
+double ArrayKernels::dot(const double* a, const double* b, size_t count) {
+    return hasAvx2() ? dotAvx2(a, b, count) : dotSse2(a, b, count);
+}
+
+double ArrayKernels::min(const double* values, size_t count) {
+    return hasAvx2() ? minAvx2(values, count) : minSse2(values, count);
+}
+
+double ArrayKernels::max(const double* values, size_t count) {
+    return hasAvx2() ? maxAvx2(values, count) : maxSse2(values, count);
+}
+
+void ArrayKernels::scale(const double* values, double factor, double* out, size_t count) {
+    hasAvx2() ? scaleAvx2(values, factor, out, count) : scaleSse2(values, factor, out, count);
+}
+
+void ArrayKernels::add(const double* a, const double* b, double* out, size_t count) {
+    hasAvx2() ? addAvx2(a, b, out, count) : addSse2(a, b, out, count);
+}
+
+void ArrayKernels::mul(const double* a, const double* b, double* out, size_t count) {
+    hasAvx2() ? mulAvx2(a, b, out, count) : mulSse2(a, b, out, count);
+}
+
+#else
+
+// Scalar fallback; the compiler may still vectorize the element-wise loops
+
+double ArrayKernels::sum(const double* values, size_t count) {
+    double total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += values[i];
+    }
+    return total;
+}
+
+double ArrayKernels::dot(const double* a, const double* b, size_t count) {
+    double total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+double ArrayKernels::min(const double* values, size_t count) {
+    double result = values[0];
+    for (size_t i = 1; i < count; i++) {
+        result = pickMin(result, values[i]);
+    }
+    return result;
+}
+
+double ArrayKernels::max(const double* values, size_t count) {
+    double result = values[0];
+    for (size_t i = 1; i < count; i++) {
+        result = pickMax(result, values[i]);
+    }
+    return result;
+}
+
+void ArrayKernels::scale(const double* values, double factor, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = values[i] * factor;
+    }
+}
+
+void ArrayKernels::add(const double* a, const double* b, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+void ArrayKernels::mul(const double* a, const double* b, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+#endif // AX_X86
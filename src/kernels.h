@@ -0,0 +1,27 @@
+// kernels.h
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+// Loops over packed number arrays for the array builtins. On x86-64 they use
+// AVX2 when the CPU has it and SSE2 otherwise; elsewhere they are plain loops.
+// Sums are accumulated in several lanes, so the last bits of a result can
+// differ from adding the elements strictly left to right.
+class ArrayKernels
+{
+public:
+    static double sum(const double* values, size_t count);
+    static double dot(const double* a, const double* b, size_t count);
+
+    // 'count' must be at least 1
+    static double min(const double* values, size_t count);
+    static double max(const double* values, size_t count);
+
+    // Element-wise, into 'out', which may be one of the inputs
+    static void scale(const double* values, double factor, double* out, size_t count);
+    static void add(const double* a, const double* b, double* out, size_t count);
+    static void mul(const double* a, const double* b, double* out, size_t count);
+};
+
+#endif // KERNELS_H
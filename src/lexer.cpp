@@ -4,39 +4,42 @@
 #include <cctype>
 #include <iostream>
 
-Lexer::Lexer(const std::string source) : source(source), current(0), line(1)
+const std::unordered_map<std::string_view, TokenType> Lexer::keywords = {
+    {"if", TokenType::IF},
+    {"else if", TokenType::ELSEIF},
+    {"else", TokenType::ELSE},
+    {"false", TokenType::FALSE},
+    {"for", TokenType::FOR},
+    {"nil", TokenType::NIL},
+    {"or", TokenType::OR},
+    {"print", TokenType::PRINT},
+    {"input", TokenType::INPUT},
+    {"var", TokenType::VAR},
+    {"loop", TokenType::LOOP},
+    {"to", TokenType::TO},
+    {"step", TokenType::STEP},
+    {"break", TokenType::BREAK},
+    {"continue", TokenType::CONTINUE},
+    {"down", TokenType::DOWN},
+    {"compeq", TokenType::COMPEQ},
+    {"compneq", TokenType::COMPNEQ},
+    {"compge", TokenType::COMPGE},
+    {"comple", TokenType::COMPLE},
+    {"compg", TokenType::COMPG},
+    {"compl", TokenType::COMPL},
+    {"and", TokenType::AND},
+    {"not", TokenType::NOT},
+    {"true", TokenType::TRUE},
+    {"return", TokenType::RETURN_KW},
+    {"fun", TokenType::FUN},
+    // {"super", TokenType::SUPER},
+    // {"this", TokenType::THIS},
+    // {"while", TokenType::WHILE},
+    // {"class", TokenType::CLASS},
+};
+
+Lexer::Lexer(std::string_view source) : source(source), current(0), line(1)
 {
-    keywords["if"] = TokenType::IF;
-    keywords["else if"] = TokenType::ELSEIF;
-    keywords["else"] = TokenType::ELSE;
-    keywords["false"] = TokenType::FALSE;
-    keywords["for"] = TokenType::FOR;
-    keywords["nil"] = TokenType::NIL;
-    keywords["or"] = TokenType::OR;
-    keywords["print"] = TokenType::PRINT;
-    keywords["input"] = TokenType::INPUT;
-    keywords["var"] = TokenType::VAR;
-    keywords["loop"] = TokenType::LOOP;
-    keywords["to"] = TokenType::TO;
-    keywords["step"] = TokenType::STEP;
-    keywords["break"] = TokenType::BREAK;
-    keywords["continue"] = TokenType::CONTINUE;
-    keywords["down"] = TokenType::DOWN;
-    keywords["compeq"] = TokenType::COMPEQ;
-    keywords["compneq"] = TokenType::COMPNEQ;
-    keywords["compge"] = TokenType::COMPGE;
-    keywords["comple"] = TokenType::COMPLE;
-    keywords["compg"] = TokenType::COMPG;
-    keywords["compl"] = TokenType::COMPL;
-    keywords["and"] = TokenType::AND;
-    keywords["not"] = TokenType::NOT;
-    keywords["true"] = TokenType::TRUE;
-    keywords["return"] = TokenType::RETURN_KW;
-    keywords["fun"] = TokenType::FUN;
-    // keywords["super"] = TokenType::SUPER;
-    // keywords["this"] = TokenType::THIS;
-    // keywords["while"] = TokenType::WHILE;
-    // keywords["class"] = TokenType::CLASS;
 }
 
 std::vector<Token> Lexer::lex()
@@ -73,12 +76,12 @@ std::vector<Token> Lexer::lex()
         else
         {
             TokenType type = identifyToken(ch);
-            tokens.push_back(Token(type, std::string(1, ch), "", line));
+            tokens.push_back(Token(type, source.substr(current, 1), line));
             advance();
         }
     }
 
-    tokens.push_back(Token(TokenType::EOF_TOKEN));
+    tokens.push_back(Token(TokenType::EOF_TOKEN, {}, line));
     return tokens;
 }
 
@@ -104,15 +107,17 @@ TokenType Lexer::identifyToken(char ch)
     case ')':
         return TokenType::RIGHT_PAREN;
     case '{':
-        return TokenType::LEFT_CURLY;
+        return TokenType::LEFT_BRACE;
     case '}':
-        return TokenType::RIGHT_CURLY;
+        return TokenType::RIGHT_BRACE;
     case '[':
         return TokenType::LEFT_BRACKET;
     case ']':
         return TokenType::RIGHT_BRACKET;
     case ',':
         return TokenType::COMMA;
+    case ':':
+        return TokenType::COLON;
     case '.':
         return TokenType::DOT;
     case '-':
@@ -219,99 +224,86 @@ bool Lexer::match(char expected)
 
 void Lexer::addToken(TokenType type)
 {
-    std::string lexeme = source.substr(current, 1);
-    tokens.push_back(Token(type, lexeme, "", line));
+    tokens.push_back(Token(type, source.substr(current, 1), line));
     advance();
 }
 
 Token Lexer::string()
 {
-    std::string lexeme;
+    int startLine = line;
     advance(); // Skip opening quote
+    size_t start = current;
     while (!isAtEnd() && currentChar() != '"')
     {
-        // Process escape sequences
-        if (currentChar() == '\\' && current + 1 < source.size())
+        if (currentChar() == '\n')
         {
-            advance(); // Skip backslash
-            switch (currentChar())
-            {
-                case 'n': lexeme += '\n'; break;  // Newline
-                case 't': lexeme += '\t'; break;  // Tab
-                case 'r': lexeme += '\r'; break;  // Carriage return
-                case '\\': lexeme += '\\'; break; // Backslash
-                case '"': lexeme += '\"'; break;  // Double quote
-                case '\'': lexeme += '\''; break; // Single quote
-                default: 
-                    lexeme += currentChar(); 
-                    break;
-            }
-            advance();
+            line++;
         }
-        else
+        // Skip the escaped character so \" does not end the string; the
+        // parser decodes escape sequences
+        if (currentChar() == '\\' && current + 1 < source.size())
         {
-            lexeme += currentChar();
             advance();
         }
+        advance();
     }
+    size_t end = current;
     advance(); // Skip closing quote
 
     Token token;
     token.type = TokenType::STRING;
-    token.lexeme = lexeme;
+    token.lexeme = source.substr(start, end - start);
+    token.line = startLine;
     return token;
 }
 
 Token Lexer::number()
 {
-    std::string lexeme;
+    size_t start = current;
 
     // Handle negative sign
     if (currentChar() == '-')
     {
-        lexeme += '-';
         advance();
     }
 
     // Collect digits before decimal point
     while (!isAtEnd() && std::isdigit(currentChar()))
     {
-        lexeme += currentChar();
         advance();
     }
 
     // Handle decimal point
     if (!isAtEnd() && currentChar() == '.')
     {
-        lexeme += '.';
         advance();
 
         while (!isAtEnd() && std::isdigit(currentChar()))
         {
-            lexeme += currentChar();
             advance();
         }
     }
 
     Token token;
     token.type = TokenType::NUMBER;
-    token.lexeme = lexeme;
+    token.lexeme = source.substr(start, current - start);
+    token.line = line;
     return token;
 }
 
 Token Lexer::identifier()
 {
-    std::string lexeme;
+    size_t start = current;
     while (!isAtEnd() && (std::isalnum(currentChar()) || currentChar() == '_'))
     {
-        lexeme += currentChar();
         advance();
     }
 
+    std::string_view lexeme = source.substr(start, current - start);
     auto it = keywords.find(lexeme);
     TokenType type = (it != keywords.end()) ? it->second : TokenType::IDENTIFIER;
 
-    return Token(type, lexeme, "", line);
+    return Token(type, lexeme, line);
 }
 
 void Lexer::scanToken()
@@ -340,6 +332,9 @@ void Lexer::scanToken()
     case ',':
         addToken(TokenType::COMMA);
         break;
+    case ':':
+        addToken(TokenType::COLON);
+        break;
     case '.':
         addToken(TokenType::DOT);
         break;
@@ -347,7 +342,7 @@ void Lexer::scanToken()
         if (current + 1 < source.size() && std::isdigit(source[current + 1]))
         {
             // This is a negative number
-            tokens.push_back(Token(TokenType::MINUS, "-", "", line));
+            tokens.push_back(Token(TokenType::MINUS, source.substr(current, 1), line));
             advance(); // Move past the minus sign
             tokens.push_back(number());
         }
@@ -6,6 +6,7 @@
 
 #include "tokens.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -13,33 +14,19 @@ class Lexer
 {
 
 public:
-    Lexer(const std::string source);
+    // The source is not copied; it must outlive the returned tokens
+    Lexer(std::string_view source);
 
     std::vector<Token> lex();
 
 private:
-    std::string source;
+    std::string_view source;
 
     size_t current;
 
     int line;
 
-    std::unordered_map<std::string, TokenType> keywords = {
-        {"break", TokenType::BREAK},
-        {"continue", TokenType::CONTINUE},
-        {"down", TokenType::DOWN},
-        {"to", TokenType::TO},
-        {"step", TokenType::STEP},
-        {"compeq", TokenType::COMPEQ},
-        {"compneq", TokenType::COMPNEQ},
-        {"compge", TokenType::COMPGE},
-        {"comple", TokenType::COMPLE},
-        {"compg", TokenType::COMPG},
-        {"compl", TokenType::COMPL},
-        {"and", TokenType::AND},
-        {"or", TokenType::OR},
-        {"not", TokenType::NOT}
-    };
+    static const std::unordered_map<std::string_view, TokenType> keywords;
 
     std::vector<Token> tokens;
 
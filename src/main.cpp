@@ -1,39 +1,74 @@
 // main.cpp
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <sstream>
+#include <memory>
 #include <cstdlib>
 #include <readline/readline.h>
 #include <readline/history.h>
-#include "lexer.h"
-#include "tokens.h"
-#include "parser.h"
-#include "interpreter.h"
+#include "cache.h"
+#include "profiler.h"
+#include "source.h"
+#include "session.h"
 
 class AxScript {
 public:
+    // Run scripts with the tree-walking Interpreter instead of the bytecode VM
+    static bool useInterpreter;
+    // Skip reading and writing the .axc bytecode cache next to the script
+    static bool noCache;
+    // Fold constants and prune constant branches before running
+    static bool optimize;
+    // Print phase timings and counters to stderr on exit, as JSON if statsJson
+    static bool showStats;
+    static bool statsJson;
+    // Write a folded-stack CPU profile here, if set
+    static std::string profilePath;
 
     static void Guide() {
         std::cout << "AxScript v1.0.0" << std::endl;
-        std::cout << "Usage: axscript [filename]" << std::endl;
+        std::cout << "Usage: axscript [--interp] [--no-cache] [-O] [--stats[=json]] [--profile=FILE] [--gc-threshold=N] [filename]" << std::endl;
     }
 
     static void runFile(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+        auto source = std::make_unique<SourceBuffer>();
+        if (!source->open(filename)) {
             std::cerr << "Error: Could not open file " << filename << std::endl;
             std::exit(65);
         }
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        run(buffer.str());
-        file.close();
+        Session session(useInterpreter, optimize);
+        if (useInterpreter || noCache) {
+            session.run(std::move(source));
+            return;
+        }
+
+        // Reuse the compiled script if it was built from this exact source
+        std::string cachePath = BytecodeCache::pathFor(filename);
+        uint64_t sourceHash = BytecodeCache::hash(source->text());
+        if (optimize) {
+            // Optimized and plain builds of a source are different caches
+            sourceHash = ~sourceHash;
+        }
+        std::shared_ptr<FunctionProto> script;
+        {
+            Stats::Timer timer(Stats::cache);
+            script = BytecodeCache::load(cachePath, sourceHash);
+        }
+        if (!script) {
+            script = session.compile(std::move(source));
+            if (!script) {
+                return;
+            }
+            Stats::Timer timer(Stats::cache);
+            BytecodeCache::save(cachePath, sourceHash, *script);
+        }
+        session.run(script);
     }
 
     static void runPrompt() {
         using_history();
         
+        // One session for the whole prompt, so definitions persist between lines
+        Session session(useInterpreter, optimize);
         std::string line;
         while (true) {
             char* lineRaw = readline(">> ");
@@ -55,34 +90,69 @@ public:
                 break;
             }
             
-            run(line);
+            session.run(std::make_unique<SourceBuffer>(line));
         }
         
         clear_history();
     }
+};
 
-    static void run(const std::string& source) {
-        try {
-            Lexer lexer(source);
-            std::vector<Token> tokens = lexer.lex();
-
-            Parser parser(tokens);
-            std::vector<std::unique_ptr<Stmt>> statements = parser.parse();
+bool AxScript::useInterpreter = false;
+bool AxScript::noCache = false;
+bool AxScript::optimize = false;
+bool AxScript::showStats = false;
+bool AxScript::statsJson = false;
+std::string AxScript::profilePath;
 
-            Interpreter interpreter;
-            interpreter.interpret(statements);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: " << e.what() << std::endl;
+int main(int argc, char* argv[]) {
+    std::string filename;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--interp") {
+            AxScript::useInterpreter = true;
+        } else if (arg == "--no-cache") {
+            AxScript::noCache = true;
+        } else if (arg == "-O") {
+            AxScript::optimize = true;
+        } else if (arg == "--stats" || arg == "--stats=json") {
+            AxScript::showStats = true;
+            AxScript::statsJson = arg == "--stats=json";
+        } else if (arg.rfind("--profile=", 0) == 0 && arg.size() > 10) {
+            AxScript::profilePath = arg.substr(10);
+        } else if (arg.rfind("--gc-threshold=", 0) == 0) {
+            // Container allocations between cycle collections, 0 for never
+            std::string count = arg.substr(arg.find('=') + 1);
+            if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+                AxScript::Guide();
+                return 64;
+            }
+            CycleCollector::threshold = std::stoul(count);
+        } else if (filename.empty()) {
+            filename = arg;
+        } else {
+            AxScript::Guide();
+            return 64;
         }
     }
-};
 
-int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        AxScript::runFile(argv[1]);
+    if (!AxScript::profilePath.empty()) {
+        Profiler::start(AxScript::profilePath);
+    }
+
+    if (!filename.empty()) {
+        AxScript::runFile(filename);
     } else {
         AxScript::Guide();
         AxScript::runPrompt();
     }
+
+    Profiler::stop();
+
+    // The session is gone; free the cycles it left behind
+    CycleCollector::collect();
+
+    if (AxScript::showStats) {
+        Stats::report(std::cerr, AxScript::statsJson);
+    }
     return 0;
 }
\ No newline at end of file
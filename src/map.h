@@ -0,0 +1,256 @@
+// map.h
+#ifndef MAP_H
+#define MAP_H
+
+#include "value.h"
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A hash map keyed by numbers, strings or booleans. Entries are kept densely
+// in insertion order; the table itself is open addressing in the style of a
+// Swiss table: slots come in groups of 16, each with a control byte holding 7
+// bits of the key's hash, so one SSE2 compare finds the candidate slots of a
+// whole group and most misses never touch an entry.
+struct ObjMap : Container {
+    struct Entry {
+        Value key;  // Undefined once the entry is removed
+        Value value;
+        uint64_t hash;
+    };
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // In insertion order, including removed entries
+    const std::vector<Entry>& entries() const {
+        return entryList;
+    }
+
+    // Null if the key is absent
+    const Value* find(const Value& key) const {
+        size_t slot = findSlot(key, hashOf(key));
+        return slot == kNoSlot ? nullptr : &entryList[slots[slot]].value;
+    }
+
+    void set(const Value& key, Value value) {
+        uint64_t hash = hashOf(key);
+        size_t slot = findSlot(key, hash);
+        if (slot != kNoSlot) {
+            entryList[slots[slot]].value = std::move(value);
+            return;
+        }
+
+        // Keep at least one slot in eight free so probing always ends;
+        // removed entries count too, until a rehash drops them
+        if ((entryList.size() + 1) * 8 > control.size() * 7) {
+            rehash();
+        }
+        slot = findFreeSlot(hash);
+        control[slot] = tagOf(hash);
+        slots[slot] = static_cast<uint32_t>(entryList.size());
+        entryList.push_back(Entry{key, std::move(value), hash});
+        count++;
+    }
+
+    // Returns whether the key was present
+    bool remove(const Value& key) {
+        size_t slot = findSlot(key, hashOf(key));
+        if (slot == kNoSlot) {
+            return false;
+        }
+        Entry& entry = entryList[slots[slot]];
+        entry.key = Value();
+        entry.value = Value();
+        control[slot] = kDeleted;
+        count--;
+        return true;
+    }
+
+    // Hashes are cached on strings, so a string key is only hashed once
+    static uint64_t hashOf(const Value& key) {
+        uint64_t bits;
+        switch (key.type()) {
+            case Value::Type::NUMBER: {
+                double number = key.number() == 0 ? 0.0 : key.number();  // -0 and 0 are one key
+                std::memcpy(&bits, &number, sizeof(bits));
+                break;
+            }
+            case Value::Type::BOOLEAN:
+                bits = key.boolean() ? 0x9e3779b97f4a7c15ull : 0x7f4a7c159e3779b9ull;
+                break;
+            case Value::Type::STRING:
+                bits = static_cast<ObjString*>(key.object())->hash();
+                break;
+            default:
+                throw std::runtime_error("Map keys must be numbers, strings or booleans.");
+        }
+
+        // Spread every input bit over the whole hash (the splitmix64 finalizer)
+        bits ^= bits >> 30;
+        bits *= 0xbf58476d1ce4e5b9ull;
+        bits ^= bits >> 27;
+        bits *= 0x94d049bb133111ebull;
+        bits ^= bits >> 31;
+        return bits;
+    }
+
+    void trace(Tracer& tracer) override {
+        for (const auto& entry : entryList) {
+            tracer.visit(entry.value);
+        }
+    }
+
+    void clearReferences() override {
+        std::vector<Entry> dropped;
+        dropped.swap(entryList);
+        control.clear();
+        slots.clear();
+        count = 0;
+    }
+
+private:
+    static constexpr size_t kGroupSize = 16;
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+    static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+
+    std::vector<int8_t> control;   // Per slot: kEmpty, kDeleted or tagOf(hash)
+    std::vector<uint32_t> slots;   // Per slot: index into entryList
+    std::vector<Entry> entryList;
+    size_t count = 0;
+
+    static int8_t tagOf(uint64_t hash) {
+        return static_cast<int8_t>(hash & 0x7f);
+    }
+
+    // Bit i is set if byte i of the group equals 'byte'
+    static uint32_t match(const int8_t* group, int8_t byte) {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; i++) {
+            mask |= static_cast<uint32_t>(group[i] == byte) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i is set if slot i of the group is empty or deleted: the only
+    // control bytes with the sign bit set
+    static uint32_t matchFree(const int8_t* group) {
+#if defined(__SSE2__)
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupSize; i++) {
+            mask |= static_cast<uint32_t>(group[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static bool sameKey(const Value& a, const Value& b) {
+        if (a.type() != b.type()) {
+            return false;
+        }
+        switch (a.type()) {
+            case Value::Type::NUMBER:
+                return sameNumber(a, b);
+            case Value::Type::BOOLEAN:
+                return a.boolean() == b.boolean();
+            case Value::Type::STRING: {
+                if (a.object() == b.object()) {
+                    return true;
+                }
+                // Distinct interned strings always differ
+                auto* x = static_cast<ObjString*>(a.object());
+                auto* y = static_cast<ObjString*>(b.object());
+                return !(x->interned && y->interned) && x->str() == y->str();
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Groups are probed at triangular offsets, which visits every group of
+    // a power-of-two table
+    size_t findSlot(const Value& key, uint64_t hash) const {
+        if (control.empty()) {
+            return kNoSlot;
+        }
+        size_t groupMask = control.size() / kGroupSize - 1;
+        size_t group = (hash >> 7) & groupMask;
+        int8_t tag = tagOf(hash);
+        for (size_t probe = 1; ; probe++) {
+            const int8_t* bytes = &control[group * kGroupSize];
+            for (uint32_t candidates = match(bytes, tag); candidates != 0; candidates &= candidates - 1) {
+                size_t slot = group * kGroupSize + __builtin_ctz(candidates);
+                const Entry& entry = entryList[slots[slot]];
+                if (entry.hash == hash && sameKey(entry.key, key)) {
+                    return slot;
+                }
+            }
+            if (match(bytes, kEmpty) != 0) {
+                return kNoSlot;
+            }
+            group = (group + probe) & groupMask;
+        }
+    }
+
+    size_t findFreeSlot(uint64_t hash) const {
+        size_t groupMask = control.size() / kGroupSize - 1;
+        size_t group = (hash >> 7) & groupMask;
+        for (size_t probe = 1; ; probe++) {
+            uint32_t free = matchFree(&control[group * kGroupSize]);
+            if (free != 0) {
+                return group * kGroupSize + __builtin_ctz(free);
+            }
+            group = (group + probe) & groupMask;
+        }
+    }
+
+    // Rebuild the table with room to double, dropping removed entries
+    void rehash() {
+        std::vector<Entry> live;
+        live.reserve(count);
+        for (auto& entry : entryList) {
+            if (!entry.key.isUndefined()) {
+                live.push_back(std::move(entry));
+            }
+        }
+        entryList.swap(live);
+
+        size_t capacity = kGroupSize;
+        while (capacity * 7 < (count + 1) * 2 * 8) {
+            capacity *= 2;
+        }
+        control.assign(capacity, kEmpty);
+        slots.assign(capacity, 0);
+        for (size_t i = 0; i < entryList.size(); i++) {
+            size_t slot = findFreeSlot(entryList[i].hash);
+            control[slot] = tagOf(entryList[i].hash);
+            slots[slot] = static_cast<uint32_t>(i);
+        }
+    }
+};
+
+inline Value makeMap() { return Value(Value::Type::MAP, new ObjMap()); }
+
+inline bool isMap(const Value& val) { return val.type() == Value::Type::MAP; }
+
+inline ObjMap& asMap(const Value& val) {
+    if (!isMap(val)) throw std::runtime_error("Value is not a map");
+    return *static_cast<ObjMap*>(val.object());
+}
+
+#endif // MAP_H
@@ -0,0 +1,403 @@
+// optimizer.h
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "visitor.h"
+#include "ast.h"
+#include "dispatch.h"
+#include "intern.h"
+#include "runtime.h"
+#include <cmath>
+#include <vector>
+
+// Optional pass (-O) that runs after the Resolver and rewrites the AST in
+// place. It folds operators whose operands are literals, drops identities
+// such as x * 1 when x is known to be a number, joins adjacent string
+// literals in a concatenation and replaces comparison statements with two
+// constant operands by the branch they take.
+//
+// Anything that would raise an error at run time, such as a division by a
+// literal zero or comparing a number with a string, is left alone, so the
+// error still happens when, and only if, that code runs. Slots were assigned
+// before the pass, so removing a branch never changes what a name refers to.
+class Optimizer : public Visitor
+{
+public:
+    explicit Optimizer(AstArena& arena) : arena(arena) {}
+
+    void optimize(std::vector<StmtPtr>& statements) {
+        for (auto& statement : statements) {
+            optimizeStmt(statement);
+        }
+    }
+
+    void visit(NumberExpr *expr) override {}
+    void visit(StringExpr *expr) override {}
+    void visit(BooleanExpr *expr) override {}
+    void visit(VariableExpr *expr) override {}
+
+    void visit(AssignExpr* expr) override {
+        optimizeExpr(expr->value);
+    }
+
+    void visit(BinaryExpr *expr) override {
+        optimizeExpr(expr->left);
+        optimizeExpr(expr->right);
+
+        Value left, right, folded;
+        if (literalValue(expr->left, left) && literalValue(expr->right, right)) {
+            if (evaluate(expr->op.type, left, right, folded)) {
+                replacement = makeLiteral(folded);
+            }
+            return;
+        }
+
+        // (x + "a") + "b" is x + "ab": once one side of a '+' is a string,
+        // every later operand is converted and appended the same way
+        auto* inner = dynamic_cast<BinaryExpr*>(expr->left.get());
+        if (expr->op.type == TokenType::PLUS && inner != nullptr && inner->op.type == TokenType::PLUS &&
+            isStringLiteral(inner->right) && literalValue(expr->right, right)) {
+            literalValue(inner->right, left);
+            inner->right = makeLiteral(concatenate(left, right));
+            replacement = std::move(expr->left);
+            return;
+        }
+
+        simplifyIdentity(expr);
+    }
+
+    void visit(CompEqExpr* expr) override {
+        optimizeExpr(expr->left);
+        optimizeExpr(expr->right);
+
+        Value left, right;
+        if (literalValue(expr->left, left) && literalValue(expr->right, right)) {
+            replacement = makeLiteral(makeBoolean(isEqual(left, right)));
+        }
+    }
+
+    void visit(ArrayExpr* expr) override {
+        for (auto& element : expr->elements) {
+            optimizeExpr(element);
+        }
+    }
+
+    void visit(FixedArrayExpr* expr) override {
+        for (auto& element : expr->elements) {
+            optimizeExpr(element);
+        }
+    }
+
+    void visit(MapExpr* expr) override {
+        for (size_t i = 0; i < expr->keys.size(); i++) {
+            optimizeExpr(expr->keys[i]);
+            optimizeExpr(expr->values[i]);
+        }
+    }
+
+    void visit(IndexExpr* expr) override {
+        optimizeExpr(expr->object);
+        optimizeExpr(expr->index);
+    }
+
+    void visit(AssignIndexExpr* expr) override {
+        optimizeExpr(expr->object);
+        optimizeExpr(expr->index);
+        optimizeExpr(expr->value);
+    }
+
+    void visit(CallExpr* expr) override {
+        optimizeExpr(expr->callee);
+        for (auto& arg : expr->arguments) {
+            optimizeExpr(arg);
+        }
+    }
+
+    void visit(PrintStmt *stmt) override {
+        optimizeExpr(stmt->expression);
+    }
+
+    void visit(VarStmt *stmt) override {
+        if (stmt->initializer) {
+            optimizeExpr(stmt->initializer);
+        }
+    }
+
+    void visit(InputStmt *stmt) override {}
+
+    void visit(BlockStmt* stmt) override {
+        optimize(stmt->statements);
+    }
+
+    void visit(LoopStmt* stmt) override {
+        optimizeExpr(stmt->from);
+        optimizeExpr(stmt->to);
+        if (stmt->step) {
+            optimizeExpr(stmt->step);
+        }
+        optimizeStmt(stmt->body);
+    }
+
+    void visit(BreakStmt* stmt) override {}
+    void visit(ContinueStmt* stmt) override {}
+
+    void visit(ExpressionStmt* stmt) override {
+        optimizeExpr(stmt->expression);
+    }
+
+    // An arm with two literal operands is decided here: if it fails it is
+    // dropped, and if it holds its body becomes the else branch, as no later
+    // arm can be reached
+    void visit(CompareStmt* stmt) override {
+        for (auto& arm : stmt->arms) {
+            optimizeExpr(arm.left);
+            optimizeExpr(arm.right);
+            optimizeStmt(arm.body);
+        }
+        optimizeStmt(stmt->elseBranch);
+
+        std::vector<CompareStmt::Arm> arms;
+        for (auto& arm : stmt->arms) {
+            Value left, right, outcome;
+            if (literalValue(arm.left, left) && literalValue(arm.right, right) &&
+                evaluate(arm.op, left, right, outcome)) {
+                if (outcome.boolean()) {
+                    stmt->elseBranch = std::move(arm.body);
+                    break;
+                }
+                continue;
+            }
+            arms.push_back(std::move(arm));
+        }
+        stmt->arms = std::move(arms);
+
+        if (stmt->arms.empty()) {
+            StmtPtr none;
+            replacementStmt = takeBranch(false, none, stmt->elseBranch);
+        }
+    }
+
+    void visit(AndStmt* stmt) override {
+        optimizeExpr(stmt->left);
+        optimizeExpr(stmt->right);
+        optimizeStmt(stmt->thenBranch);
+        optimizeStmt(stmt->elseBranch);
+    }
+
+    void visit(OrStmt* stmt) override {
+        optimizeExpr(stmt->left);
+        optimizeExpr(stmt->right);
+        optimizeStmt(stmt->thenBranch);
+        optimizeStmt(stmt->elseBranch);
+    }
+
+    void visit(NotStmt* stmt) override {
+        optimizeExpr(stmt->operand);
+        optimizeStmt(stmt->thenBranch);
+        for (auto& branch : stmt->elseIfBranches) {
+            optimizeExpr(branch.first);
+            optimizeStmt(branch.second);
+        }
+        optimizeStmt(stmt->elseBranch);
+
+        Value operand;
+        if (literalValue(stmt->operand, operand)) {
+            replacementStmt = takeBranch(!isTruthy(operand), stmt->thenBranch, stmt->elseBranch);
+        }
+    }
+
+    // The conditions leave their outcome in the engines' result, so they
+    // are only folded inside, never replaced
+    void visit(AndConditionStmt* stmt) override {
+        optimizeConditions(stmt);
+    }
+
+    void visit(OrConditionStmt* stmt) override {
+        optimizeConditions(stmt);
+    }
+
+    void visit(FunctionStmt* stmt) override {
+        optimize(stmt->body);
+    }
+
+    void visit(ReturnStmt* stmt) override {
+        if (stmt->value) {
+            optimizeExpr(stmt->value);
+        }
+    }
+
+private:
+    AstArena& arena;
+
+    // Set by a visit when the node should be swapped for another; the
+    // caller that owns the link installs it
+    ExprPtr replacement;
+    StmtPtr replacementStmt;
+
+    void optimizeExpr(ExprPtr& expr) {
+        expr->accept(this);
+        if (replacement) {
+            expr = std::move(replacement);
+        }
+    }
+
+    void optimizeStmt(StmtPtr& stmt) {
+        if (!stmt) {
+            return;
+        }
+        stmt->accept(this);
+        if (replacementStmt) {
+            stmt = std::move(replacementStmt);
+        }
+    }
+
+    void optimizeConditions(ConditionStmt* stmt) {
+        for (auto& condition : stmt->conditions) {
+            condition->accept(this);
+            replacementStmt = nullptr;
+        }
+        optimizeStmt(stmt->thenBranch);
+        optimizeStmt(stmt->elseBranch);
+    }
+
+    StmtPtr takeBranch(bool condition, StmtPtr& thenBranch, StmtPtr& elseBranch) {
+        StmtPtr& taken = condition ? thenBranch : elseBranch;
+        if (taken) {
+            return std::move(taken);
+        }
+        return arena.make<BlockStmt>(std::vector<StmtPtr>());
+    }
+
+    // Drops the operation when the other operand is a number, which the
+    // operator would otherwise have checked. x + 0 is kept: -0 + 0 is 0.
+    // x / 1 is kept too, as division turns an integer into a double, and
+    // so are x * 1.0 and x - 0.0.
+    void simplifyIdentity(BinaryExpr* expr) {
+        switch (expr->op.type) {
+            case TokenType::STAR:
+                if (integerLiteral(expr->right, 1) && isNumeric(expr->left)) {
+                    replacement = std::move(expr->left);
+                } else if (integerLiteral(expr->left, 1) && isNumeric(expr->right)) {
+                    replacement = std::move(expr->right);
+                }
+                break;
+            case TokenType::MINUS:
+                if (integerLiteral(expr->right, 0) && isNumeric(expr->left)) {
+                    replacement = std::move(expr->left);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Expressions that always produce a number when they produce anything
+    static bool isNumeric(const ExprPtr& expr) {
+        if (dynamic_cast<NumberExpr*>(expr.get()) != nullptr) {
+            return true;
+        }
+        auto* binary = dynamic_cast<BinaryExpr*>(expr.get());
+        if (binary == nullptr) {
+            return false;
+        }
+        switch (binary->op.type) {
+            case TokenType::MINUS:
+            case TokenType::STAR:
+            case TokenType::SLASH:
+            case TokenType::PERCENT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool isStringLiteral(const ExprPtr& expr) {
+        return dynamic_cast<StringExpr*>(expr.get()) != nullptr;
+    }
+
+    static bool integerLiteral(const ExprPtr& expr, int64_t value) {
+        auto* literal = dynamic_cast<NumberExpr*>(expr.get());
+        return literal != nullptr && literal->integer && literal->integerValue == value;
+    }
+
+    ExprPtr makeLiteral(const Value& value) {
+        switch (value.type()) {
+            case Value::Type::NUMBER:
+                if (value.isInteger()) {
+                    return arena.make<NumberExpr>(value.integer());
+                }
+                return arena.make<NumberExpr>(value.number());
+            case Value::Type::BOOLEAN:
+                return arena.make<BooleanExpr>(value.boolean());
+            default:
+                return arena.make<StringExpr>(StringTable::intern(asString(value)));
+        }
+    }
+
+    // Applies a binary operator to two literals as the engines would.
+    // Returns false for anything that would raise an error.
+    static bool evaluate(TokenType op, const Value& left, const Value& right, Value& out) {
+        bool numbers = isNumber(left) && isNumber(right);
+        bool strings = isString(left) && isString(right);
+        double a = numbers ? asNumber(left) : 0;
+        double b = numbers ? asNumber(right) : 0;
+
+        switch (op) {
+            case TokenType::PLUS:
+                if (isString(left) || isString(right)) {
+                    out = concatenate(left, right);
+                } else if (numbers) {
+                    out = addNumbers(left, right);
+                } else {
+                    return false;
+                }
+                return true;
+            case TokenType::MINUS:
+                if (!numbers) {
+                    return false;
+                }
+                out = subtractNumbers(left, right);
+                return true;
+            case TokenType::STAR:
+                if (!numbers) {
+                    return false;
+                }
+                out = multiplyNumbers(left, right);
+                return true;
+            case TokenType::SLASH:
+                if (!numbers || b == 0) {
+                    return false;
+                }
+                out = makeNumber(a / b);
+                return true;
+            case TokenType::PERCENT:
+                if (!numbers || b == 0) {
+                    return false;
+                }
+                out = moduloNumbers(left, right);
+                return true;
+            case TokenType::GREATER:
+            case TokenType::GREATER_EQUAL:
+            case TokenType::LESS:
+            case TokenType::LESS_EQUAL:
+                if (!numbers && !strings) {
+                    return false;
+                }
+                out = makeBoolean(compareValues(op == TokenType::GREATER ? Comparison::GREATER
+                                              : op == TokenType::GREATER_EQUAL ? Comparison::GREATER_EQUAL
+                                              : op == TokenType::LESS ? Comparison::LESS : Comparison::LESS_EQUAL,
+                                              left, right));
+                return true;
+            case TokenType::EQUAL_EQUAL:
+                out = makeBoolean(isEqual(left, right));
+                return true;
+            case TokenType::BANG_EQUAL:
+                out = makeBoolean(!isEqual(left, right));
+                return true;
+            default:
+                return false;
+        }
+    }
+};
+
+#endif // OPTIMIZER_H
@@ -4,19 +4,25 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include <charconv>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 class Parser
 {
 public:
-    Parser(const std::vector<Token> &tokens) : tokens(tokens), current(0) {}
+    // Nodes are allocated in 'arena', which must outlive the returned statements
+    Parser(const std::vector<Token> &tokens, AstArena &arena) : tokens(tokens), arena(arena), current(0) {}
 
-    std::vector<std::unique_ptr<Stmt>> parse()
+    std::vector<StmtPtr> parse()
     {
-        std::vector<std::unique_ptr<Stmt>> statements;
+        std::vector<StmtPtr> statements;
         while (!isAtEnd())
         {
             try
@@ -36,22 +42,31 @@ public:
     }
 
 private:
+    static inline const std::vector<TokenType> kComparisonKeywords = {
+        TokenType::COMPEQ, TokenType::COMPNEQ, TokenType::COMPGE,
+        TokenType::COMPLE, TokenType::COMPG, TokenType::COMPL
+    };
+
     const std::vector<Token> &tokens;
+    AstArena &arena;
     size_t current;
 
-    std::unique_ptr<Stmt> declaration()
+    StmtPtr declaration()
     {
+        int line = peek().line;
+        StmtPtr stmt;
         if (match({TokenType::FUN})) {
-            return functionDeclaration("function");
-        }
-        if (match({TokenType::VAR}))
-        {
-            return varDeclaration();
+            stmt = functionDeclaration("function");
+        } else if (match({TokenType::VAR})) {
+            stmt = varDeclaration();
+        } else {
+            return statement();
         }
-        return statement();
+        stmt->line = line;
+        return stmt;
     }
 
-    std::unique_ptr<Stmt> functionDeclaration(const std::string& kind) {
+    StmtPtr functionDeclaration(const std::string& kind) {
         Token name = consume(TokenType::IDENTIFIER, "Expect " + kind + " name.");
         consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
         
@@ -70,15 +85,26 @@ private:
         consume(TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
         auto body = block();
         
-        std::vector<std::unique_ptr<Stmt>> functionBody;
+        std::vector<StmtPtr> functionBody;
         for (auto& stmt : dynamic_cast<BlockStmt*>(body.get())->statements) {
             functionBody.push_back(std::move(stmt));
         }
         
-        return std::make_unique<FunctionStmt>(name, parameters, std::move(functionBody));
+        return arena.make<FunctionStmt>(name, parameters, std::move(functionBody));
     }
 
-    std::unique_ptr<Stmt> statement()
+    // Every statement records the line it starts on
+    StmtPtr statement()
+    {
+        int line = peek().line;
+        StmtPtr stmt = statementBody();
+        if (stmt) {
+            stmt->line = line;
+        }
+        return stmt;
+    }
+
+    StmtPtr statementBody()
     {
         if (match({TokenType::RETURN_KW})) {
             return returnStatement();
@@ -99,12 +125,12 @@ private:
         if (match({TokenType::BREAK}))
         {
             consume(TokenType::SEMICOLON, "Expect ';' after 'break'.");
-            return std::make_unique<BreakStmt>();
+            return arena.make<BreakStmt>();
         }
         if (match({TokenType::CONTINUE}))
         {
             consume(TokenType::SEMICOLON, "Expect ';' after 'continue'.");
-            return std::make_unique<ContinueStmt>();
+            return arena.make<ContinueStmt>();
         }
 
         if (match({TokenType::LEFT_BRACE}))
@@ -112,467 +138,139 @@ private:
             return block();
         }
 
-        if (match({TokenType::COMPEQ})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            if (check(TokenType::AND)) {
-                auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPEQ);
-                return andStmt;
-            }
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPEQ);
-                return orStmt;
-            }
-            
-            // Regular compeq statement
-            auto thenBranch = statement();
-            std::unique_ptr<Stmt> elseBranch = nullptr;
-            if (match({TokenType::ELSE})) {
-                if (peek().type == TokenType::IF) {
-                    advance(); // consume IF
-                    if (match({TokenType::COMPEQ})) {
-                        elseBranch = compEqStatement();
-                    }
-                } else {
-                    elseBranch = statement();
-                }
-            }
-            
-            return std::make_unique<CompEqStmt>(
-                std::move(leftExpr), 
-                std::move(rightExpr), 
-                std::move(thenBranch), 
-                std::move(elseBranch)
-            );
-        }
-        if (match({TokenType::COMPNEQ})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'compneq'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPNEQ);
-            if (andStmt) return andStmt;
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPNEQ);
-                return orStmt;
-            }
-            
-            // If not part of AND or OR, continue with regular compneq
-            return compNeqStatementBody(std::move(leftExpr), std::move(rightExpr));
-        }
-        if (match({TokenType::COMPGE})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'compge'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPGE);
-            if (andStmt) return andStmt;
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPGE);
-                return orStmt;
-            }
-            
-            // If not part of AND or OR, continue with regular compge
-            return compGeStatementBody(std::move(leftExpr), std::move(rightExpr));
-        }
-        if (match({TokenType::COMPLE})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'comple'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPLE);
-            if (andStmt) return andStmt;
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPLE);
-                return orStmt;
-            }
-            
-            // If not part of AND or OR, continue with regular comple
-            return compLeStatementBody(std::move(leftExpr), std::move(rightExpr));
-        }
-        if (match({TokenType::COMPG})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'compg'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPG);
-            if (andStmt) return andStmt;
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPG);
-                return orStmt;
-            }
-            
-            // If not part of AND or OR, continue with regular compg
-            return compGStatementBody(std::move(leftExpr), std::move(rightExpr));
-        }
-        if (match({TokenType::COMPL})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after 'compl'.");
-            auto leftExpr = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand.");
-            auto rightExpr = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-            
-            // First check for AND
-            auto andStmt = handleAND(std::move(leftExpr), std::move(rightExpr), TokenType::COMPL);
-            if (andStmt) return andStmt;
-            
-            // Then check for OR
-            if (check(TokenType::OR)) {
-                auto orStmt = handleOR(std::move(leftExpr), std::move(rightExpr), TokenType::COMPL);
-                return orStmt;
-            }
-            
-            // If not part of AND or OR, continue with regular compl
-            return compLStatementBody(std::move(leftExpr), std::move(rightExpr));
+        if (match(kComparisonKeywords)) {
+            return comparisonStatement(previous());
         }
 
         return expressionStatement();
     }
 
-    std::unique_ptr<Stmt> block() {
-        std::vector<std::unique_ptr<Stmt>> statements;
+    StmtPtr block() {
+        std::vector<StmtPtr> statements;
         while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
             statements.push_back(declaration());
         }
         consume(TokenType::RIGHT_BRACE, "Expect '}' after block.");
-        return std::make_unique<BlockStmt>(std::move(statements));
+        return arena.make<BlockStmt>(std::move(statements));
     }
 
-    std::unique_ptr<Stmt> returnStatement() {
+    StmtPtr returnStatement() {
         Token keyword = previous();
-        std::unique_ptr<Expr> value = nullptr;
+        ExprPtr value = nullptr;
         
         if (!check(TokenType::SEMICOLON)) {
             value = expression();
         }
         
         consume(TokenType::SEMICOLON, "Expect ';' after return value.");
-        return std::make_unique<ReturnStmt>(keyword, std::move(value));
+        return arena.make<ReturnStmt>(keyword, std::move(value));
     }
 
-    std::unique_ptr<Stmt> expressionStatement()
+    StmtPtr expressionStatement()
     {
         auto expr = expression();
         consume(TokenType::SEMICOLON, "Expect ';' after expression.");
-        return std::make_unique<ExpressionStmt>(std::move(expr));
+        return arena.make<ExpressionStmt>(std::move(expr));
     }
 
-    std::unique_ptr<Stmt> compEqStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-        auto left = expression();
-        consume(TokenType::COMMA, "Expect ',' after left operand.");
-        auto right = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
+    // After a comparison keyword: compeq(a, b) and the rest. Followed by
+    // 'and' or 'or' it starts a chain of conditions; otherwise it is the
+    // first arm of a CompareStmt, and each 'else if' adds another arm.
+    StmtPtr comparisonStatement(const Token& keyword) {
+        auto [left, right] = comparisonOperands(keyword);
 
-        auto thenBranch = statement();
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else if and else
-        if (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume IF
-                if (match({TokenType::COMPEQ})) {
-                    elseBranch = compEqStatement();
-                }
-            } else {
-                elseBranch = statement();
-            }
+        if (check(TokenType::AND)) {
+            return handleAND(std::move(left), std::move(right), keyword.type);
         }
-        
-        return std::make_unique<CompEqStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch), 
-            std::move(elseBranch)
-        );
-    }
-
-    std::unique_ptr<Stmt> compNeqStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'compneq'.");
-        auto left = expression();
-        consume(TokenType::COMMA, "Expect ',' after left operand.");
-        auto right = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-        
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
+        if (check(TokenType::OR)) {
+            return handleOR(std::move(left), std::move(right), keyword.type);
         }
-        
-        return std::make_unique<CompNeqStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
 
-    std::unique_ptr<Stmt> compGeStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'compge'.");
-        auto left = expression();
-        consume(TokenType::COMMA, "Expect ',' after left operand.");
-        auto right = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-        
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
-        }
-        
-        return std::make_unique<CompGeStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
+        std::vector<CompareStmt::Arm> arms;
+        arms.push_back(CompareStmt::Arm{comparisonOperator(keyword.type), std::move(left),
+                                        std::move(right), statement()});
+        StmtPtr elseBranch = nullptr;
 
-    std::unique_ptr<Stmt> compLeStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'comple'.");
-        auto left = expression();
-        consume(TokenType::COMMA, "Expect ',' after left operand.");
-        auto right = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-        
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
         while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
+            if (!match({TokenType::IF})) {
                 elseBranch = statement();
                 break;
             }
-        }
-        
-        return std::make_unique<CompLeStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
-
-    std::unique_ptr<Stmt> compGStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'compg'.");
-        auto left = expression();
-        consume(TokenType::COMMA, "Expect ',' after left operand.");
-        auto right = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-        
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        while (match({TokenType::ELSE})) {
-            // Check for 'else if'
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-
-                // Handle AND/OR conditions in else-if
-                auto condition = handleElseIfCondition();
-                if (condition) {
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), statement()));
-                }
-            } else {
-                elseBranch = statement();
-                break;
+            if (!match(kComparisonKeywords)) {
+                throw std::runtime_error("Expect a comparison after 'else if'.");
             }
-        }
-        
-        return std::make_unique<CompGStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
+            Token next = previous();
+            auto [nextLeft, nextRight] = comparisonOperands(next);
 
-    std::unique_ptr<Expr> handleElseIfCondition() {
-        if (match({TokenType::COMPEQ})) {
-            consume(TokenType::LEFT_PAREN, "Expect '(' after comparison operator");
-            auto left = expression();
-            consume(TokenType::COMMA, "Expect ',' after left operand");
-            auto right = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand");
-
-            auto condition = std::make_unique<CompEqExpr>(std::move(left), std::move(right));
-
-            // Check for AND/OR
+            // The and/or chain takes the rest of the statement, its else included
             if (check(TokenType::AND) || check(TokenType::OR)) {
-                TokenType logicalOp = peek().type;
-                advance(); // consume AND/OR
-
-                auto nextCondition = handleElseIfCondition();
-                // Create a binary expression joining the conditions
-                auto combinedCondition = std::make_unique<CompEqExpr>(
-                    std::move(condition),
-                    std::move(nextCondition)
-                );
-                return combinedCondition;
+                elseBranch = handleLogicalOperator(std::move(nextLeft), std::move(nextRight),
+                                                   next.type, peek().type);
+                break;
             }
-
-            return condition;
+            arms.push_back(CompareStmt::Arm{comparisonOperator(next.type), std::move(nextLeft),
+                                            std::move(nextRight), statement()});
         }
-        return nullptr;
+
+        return arena.make<CompareStmt>(std::move(arms), std::move(elseBranch));
     }
 
-    std::unique_ptr<Stmt> compLStatement() {
-        consume(TokenType::LEFT_PAREN, "Expect '(' after 'compl'.");
+    std::pair<ExprPtr, ExprPtr> comparisonOperands(const Token& keyword) {
+        std::string name(keyword.lexeme);
+        consume(TokenType::LEFT_PAREN, "Expect '(' after '" + name + "'.");
         auto left = expression();
         consume(TokenType::COMMA, "Expect ',' after left operand.");
         auto right = expression();
         consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-        
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
+        return {std::move(left), std::move(right)};
+    }
+
+    // The binary operator a comparison keyword stands for
+    static TokenType comparisonOperator(TokenType keyword) {
+        switch (keyword) {
+            case TokenType::COMPEQ: return TokenType::EQUAL_EQUAL;
+            case TokenType::COMPNEQ: return TokenType::BANG_EQUAL;
+            case TokenType::COMPGE: return TokenType::GREATER_EQUAL;
+            case TokenType::COMPLE: return TokenType::LESS_EQUAL;
+            case TokenType::COMPG: return TokenType::GREATER;
+            default: return TokenType::LESS;
         }
-        
-        return std::make_unique<CompLStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
     }
 
-    std::unique_ptr<Stmt> printStatement()
+    StmtPtr printStatement()
     {
         auto value = expression();
         consume(TokenType::SEMICOLON, "Expect ';' after value.");
-        return std::make_unique<PrintStmt>(std::move(value));
+        return arena.make<PrintStmt>(std::move(value));
     }
 
-    std::unique_ptr<Stmt> InputStatement()
+    StmtPtr InputStatement()
     {
         Token variableName = consume(TokenType::IDENTIFIER, "Expect variable name.");
         consume(TokenType::SEMICOLON, "Expect ';' after variable name.");
-        return std::make_unique<InputStmt>(variableName);
+        return arena.make<InputStmt>(variableName);
     }
 
-    std::unique_ptr<Stmt> varDeclaration()
+    StmtPtr varDeclaration()
     {
         Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
 
-        std::unique_ptr<Expr> initializer = nullptr;
+        ExprPtr initializer = nullptr;
         if (match({TokenType::EQUAL}))
         {
             initializer = expression();
         }
 
         consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-        return std::make_unique<VarStmt>(name, std::move(initializer));
+        return arena.make<VarStmt>(name, std::move(initializer));
     }
 
-    std::unique_ptr<Expr> expression()
+    ExprPtr expression()
     {
         return assignment();
     }
 
-    std::unique_ptr<Expr> assignment() {
+    ExprPtr assignment() {
         auto expr = equality();
 
         if (match({TokenType::EQUAL})) {
@@ -581,17 +279,17 @@ private:
             // Check for fixed-size array initialization pattern: array[5] = {1, 2, 3, 4, 5}
             if (auto* indexExpr = dynamic_cast<IndexExpr*>(expr.get())) {
                 // Check for array literal init with curly braces
-                if (check(TokenType::LEFT_CURLY)) {
+                if (check(TokenType::LEFT_BRACE)) {
                     advance(); // consume '{'
                     
-                    std::vector<std::unique_ptr<Expr>> elements;
-                    if (!check(TokenType::RIGHT_CURLY)) {
+                    std::vector<ExprPtr> elements;
+                    if (!check(TokenType::RIGHT_BRACE)) {
                         do {
                             elements.push_back(expression());
                         } while (match({TokenType::COMMA}));
                     }
                     
-                    consume(TokenType::RIGHT_CURLY, "Expect '}' after array elements.");
+                    consume(TokenType::RIGHT_BRACE, "Expect '}' after array elements.");
                     
                     // Extract size from the index expression
                     int arraySize = 0;
@@ -602,9 +300,9 @@ private:
                     }
                     
                     // Create FixedArrayExpr with the size and elements
-                    return std::make_unique<AssignExpr>(
+                    return arena.make<AssignExpr>(
                         dynamic_cast<VariableExpr*>(indexExpr->object.get())->name,
-                        std::make_unique<FixedArrayExpr>(arraySize, std::move(elements))
+                        arena.make<FixedArrayExpr>(arraySize, std::move(elements))
                     );
                 }
             }
@@ -613,10 +311,10 @@ private:
 
             if (auto* varExpr = dynamic_cast<VariableExpr*>(expr.get())) {
                 Token name = varExpr->name;
-                return std::make_unique<AssignExpr>(name, std::move(value));
+                return arena.make<AssignExpr>(name, std::move(value));
             } else if (auto* indexExpr = dynamic_cast<IndexExpr*>(expr.get())) {
                 // Handle assigning to array index: arr[idx] = value
-                return std::make_unique<AssignIndexExpr>(
+                return arena.make<AssignIndexExpr>(
                     std::move(indexExpr->object),
                     std::move(indexExpr->index),
                     std::move(value)
@@ -629,7 +327,7 @@ private:
         return expr;
     }
 
-    std::unique_ptr<Expr> equality()
+    ExprPtr equality()
     {
         auto expr = comparison();
 
@@ -637,19 +335,19 @@ private:
         {
             Token op = previous();
             auto right = comparison();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+            expr = arena.make<BinaryExpr>(std::move(expr), op, std::move(right));
         }
 
         if (match({TokenType::COMPEQ})) {
             auto left = std::move(expr);
             auto right = comparison();
-            expr = std::make_unique<CompEqExpr>(std::move(left), std::move(right));
+            expr = arena.make<CompEqExpr>(std::move(left), std::move(right));
         }
 
         return expr;
     }
 
-    std::unique_ptr<Expr> comparison()
+    ExprPtr comparison()
     {
         auto expr = term();
 
@@ -658,13 +356,13 @@ private:
         {
             Token op = previous();
             auto right = term();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+            expr = arena.make<BinaryExpr>(std::move(expr), op, std::move(right));
         }
 
         return expr;
     }
 
-    std::unique_ptr<Expr> term()
+    ExprPtr term()
     {
         auto expr = factor();
 
@@ -672,13 +370,13 @@ private:
         {
             Token op = previous();
             auto right = factor();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+            expr = arena.make<BinaryExpr>(std::move(expr), op, std::move(right));
         }
 
         return expr;
     }
 
-    std::unique_ptr<Expr> factor()
+    ExprPtr factor()
     {
         auto expr = unary();
 
@@ -686,44 +384,39 @@ private:
         {
             Token op = previous();
             auto right = unary();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+            expr = arena.make<BinaryExpr>(std::move(expr), op, std::move(right));
         }
 
         return expr;
     }
 
-    std::unique_ptr<Expr> primary()
+    ExprPtr primary()
     {
         if (match({TokenType::TRUE})) {
-            return std::make_unique<BooleanExpr>(true);
+            return arena.make<BooleanExpr>(true);
         }
         
         if (match({TokenType::FALSE})) {
-            return std::make_unique<BooleanExpr>(false);
+            return arena.make<BooleanExpr>(false);
         }
         
         if (match({TokenType::MINUS})) {
             if (match({TokenType::NUMBER})) {
-                std::string numStr = "-" + previous().lexeme;
-                return std::make_unique<NumberExpr>(std::stod(numStr));
+                return parseNumber(previous().lexeme, true);
             }
             throw std::runtime_error("Expected number after minus sign.");
         }
         
         if (match({TokenType::NUMBER})) {
-            try {
-                return std::make_unique<NumberExpr>(std::stod(previous().lexeme));
-            } catch (const std::exception& e) {
-                throw std::runtime_error("Invalid number format");
-            }
+            return parseNumber(previous().lexeme, false);
         }
         if (match({TokenType::STRING}))
         {
-            return std::make_unique<StringExpr>(previous().lexeme);
+            return arena.make<StringExpr>(StringTable::intern(unescape(previous().lexeme)));
         }
         if (match({TokenType::IDENTIFIER}))
         {
-            return std::make_unique<VariableExpr>(previous());
+            return arena.make<VariableExpr>(previous());
         }
         if (match({TokenType::LEFT_PAREN}))
         {
@@ -734,7 +427,7 @@ private:
         
         // Handle array literals
         if (match({TokenType::LEFT_BRACKET})) {
-            std::vector<std::unique_ptr<Expr>> elements;
+            std::vector<ExprPtr> elements;
             
             // Check for empty array first
             if (!check(TokenType::RIGHT_BRACKET)) {
@@ -744,14 +437,31 @@ private:
             }
             
             consume(TokenType::RIGHT_BRACKET, "Expect ']' after array elements.");
-            return std::make_unique<ArrayExpr>(std::move(elements));
+            return arena.make<ArrayExpr>(std::move(elements));
+        }
+        
+        // Handle map literals; a brace never starts a block inside an expression
+        if (match({TokenType::LEFT_BRACE})) {
+            std::vector<ExprPtr> keys;
+            std::vector<ExprPtr> values;
+            
+            if (!check(TokenType::RIGHT_BRACE)) {
+                do {
+                    keys.push_back(expression());
+                    consume(TokenType::COLON, "Expect ':' after map key.");
+                    values.push_back(expression());
+                } while (match({TokenType::COMMA}));
+            }
+            
+            consume(TokenType::RIGHT_BRACE, "Expect '}' after map entries.");
+            return arena.make<MapExpr>(std::move(keys), std::move(values));
         }
         
         throw std::runtime_error("Expect expression.");
     }
 
     // Add array indexing in the call/subscript precedence level between primary and unary
-    std::unique_ptr<Expr> call() {
+    ExprPtr call() {
         auto expr = primary();
         
         while (true) {
@@ -761,7 +471,7 @@ private:
                 // Array indexing: array[index]
                 auto index = expression();
                 consume(TokenType::RIGHT_BRACKET, "Expect ']' after index.");
-                expr = std::make_unique<IndexExpr>(std::move(expr), std::move(index));
+                expr = arena.make<IndexExpr>(std::move(expr), std::move(index));
             } else {
                 break;
             }
@@ -770,8 +480,8 @@ private:
         return expr;
     }
 
-    std::unique_ptr<Expr> finishCall(std::unique_ptr<Expr> callee) {
-        std::vector<std::unique_ptr<Expr>> arguments;
+    ExprPtr finishCall(ExprPtr callee) {
+        std::vector<ExprPtr> arguments;
         
         if (!check(TokenType::RIGHT_PAREN)) {
             do {
@@ -784,15 +494,15 @@ private:
         
         Token paren = consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
         
-        return std::make_unique<CallExpr>(std::move(callee), paren, std::move(arguments));
+        return arena.make<CallExpr>(std::move(callee), paren, std::move(arguments));
     }
 
-    std::unique_ptr<Expr> unary() {
+    ExprPtr unary() {
         // Call 'call()' instead of 'primary()' to handle array indexing
         return call();
     }
 
-    std::unique_ptr<Stmt> loopStatement()
+    StmtPtr loopStatement()
     {
         Token var = consume(TokenType::IDENTIFIER, "Expect variable name after 'loop'.");
         consume(TokenType::EQUAL, "Expect '=' after variable name.");
@@ -803,34 +513,34 @@ private:
 
         bool isDownward = match({TokenType::DOWN});
 
-        std::unique_ptr<Expr> step = nullptr;
+        ExprPtr step = nullptr;
         if (match({TokenType::STEP}))
         {
             step = expression();
         }
 
-        std::unique_ptr<Stmt> body;
+        StmtPtr body;
         if (match({TokenType::LEFT_BRACE}))
         {
-            std::vector<std::unique_ptr<Stmt>> statements;
+            std::vector<StmtPtr> statements;
             while (!check(TokenType::RIGHT_BRACE) && !isAtEnd())
             {
                 statements.push_back(declaration());
             }
             consume(TokenType::RIGHT_BRACE, "Expect '}' after loop body.");
-            body = std::make_unique<BlockStmt>(std::move(statements));
+            body = arena.make<BlockStmt>(std::move(statements));
         }
         else
         {
             body = statement();
         }
 
-        return std::make_unique<LoopStmt>(var, std::move(from), std::move(to),
+        return arena.make<LoopStmt>(var, std::move(from), std::move(to),
                                           std::move(step), std::move(body), isDownward);
     }
 
-    std::unique_ptr<Stmt> parseLogicalExpression() {
-        std::vector<std::unique_ptr<Stmt>> conditions;
+    StmtPtr parseLogicalExpression() {
+        std::vector<StmtPtr> conditions;
         
         conditions.push_back(parseCondition());
         
@@ -846,17 +556,17 @@ private:
         auto thenBranch = statement();
         
         if (isAnd) {
-            return std::make_unique<AndConditionStmt>(std::move(conditions), std::move(thenBranch));
+            return arena.make<AndConditionStmt>(std::move(conditions), std::move(thenBranch));
         } else if (isOr) {
-            return std::make_unique<OrConditionStmt>(std::move(conditions), std::move(thenBranch));
+            return arena.make<OrConditionStmt>(std::move(conditions), std::move(thenBranch));
         }
         
         return std::move(conditions[0]);
     }
 
-    std::unique_ptr<Stmt> parseCondition() {
+    StmtPtr parseCondition() {
         if (match({TokenType::COMPEQ})) {
-            return compEqStatement();
+            return comparisonStatement(previous());
         }
         throw std::runtime_error("Expected condition");
     }
@@ -937,15 +647,15 @@ private:
     }
 
     // Add a more generic handleLogicalOperators method to handle both AND and OR
-    std::unique_ptr<Stmt> handleLogicalOperator(std::unique_ptr<Expr> leftExpr, std::unique_ptr<Expr> rightExpr, 
+    StmtPtr handleLogicalOperator(ExprPtr leftExpr, ExprPtr rightExpr, 
                                                TokenType opType, TokenType logicalOp) {
         if (check(logicalOp)) {
             advance(); // consume AND or OR
             
             // Create first condition
-            std::vector<std::unique_ptr<Stmt>> conditions;
-            conditions.push_back(std::make_unique<ExpressionStmt>(
-                std::make_unique<CompEqExpr>(std::move(leftExpr), std::move(rightExpr))
+            std::vector<StmtPtr> conditions;
+            conditions.push_back(arena.make<ExpressionStmt>(
+                arena.make<CompEqExpr>(std::move(leftExpr), std::move(rightExpr))
             ));
             
             // Parse next comparison
@@ -957,8 +667,8 @@ private:
                 consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand");
                 
                 // Add second condition
-                conditions.push_back(std::make_unique<ExpressionStmt>(
-                    std::make_unique<CompEqExpr>(std::move(nextLeft), std::move(nextRight))
+                conditions.push_back(arena.make<ExpressionStmt>(
+                    arena.make<CompEqExpr>(std::move(nextLeft), std::move(nextRight))
                 ));
                 
                 // Handle any additional conditions
@@ -970,27 +680,27 @@ private:
                         auto nextRight = expression();
                         consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand");
                         
-                        conditions.push_back(std::make_unique<ExpressionStmt>(
-                            std::make_unique<CompEqExpr>(std::move(nextLeft), std::move(nextRight))
+                        conditions.push_back(arena.make<ExpressionStmt>(
+                            arena.make<CompEqExpr>(std::move(nextLeft), std::move(nextRight))
                         ));
                     }
                 }
             }
             
             auto thenBranch = statement();
-            std::unique_ptr<Stmt> elseBranch = nullptr;
+            StmtPtr elseBranch = nullptr;
             if (match({TokenType::ELSE})) {
                 elseBranch = statement();
             }
             
             if (logicalOp == TokenType::AND) {
-                return std::make_unique<AndConditionStmt>(
+                return arena.make<AndConditionStmt>(
                     std::move(conditions),
                     std::move(thenBranch),
                     std::move(elseBranch)
                 );
             } else {
-                return std::make_unique<OrConditionStmt>(
+                return arena.make<OrConditionStmt>(
                     std::move(conditions),
                     std::move(thenBranch),
                     std::move(elseBranch)
@@ -1001,184 +711,52 @@ private:
     }
 
     // Simplified wrapper methods for specific logical operators
-    std::unique_ptr<Stmt> handleAND(std::unique_ptr<Expr> leftExpr, std::unique_ptr<Expr> rightExpr, TokenType opType) {
+    StmtPtr handleAND(ExprPtr leftExpr, ExprPtr rightExpr, TokenType opType) {
         return handleLogicalOperator(std::move(leftExpr), std::move(rightExpr), opType, TokenType::AND);
     }
     
-    std::unique_ptr<Stmt> handleOR(std::unique_ptr<Expr> leftExpr, std::unique_ptr<Expr> rightExpr, TokenType opType) {
+    StmtPtr handleOR(ExprPtr leftExpr, ExprPtr rightExpr, TokenType opType) {
         return handleLogicalOperator(std::move(leftExpr), std::move(rightExpr), opType, TokenType::OR);
     }
 
-    // Helper methods for the statement body of each comparison type
-    std::unique_ptr<Stmt> compNeqStatementBody(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else-if and else branches
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
-        }
-        
-        return std::make_unique<CompNeqStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
-
-    std::unique_ptr<Stmt> compGeStatementBody(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else-if and else branches
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
+    // A lexeme of digits alone is an integer when it fits in 64 bits, and
+    // anything else a double. -0 stays a double, so that 1 / -0 keeps its sign.
+    ExprPtr parseNumber(std::string_view lexeme, bool negative) {
+        const char* first = lexeme.data();
+        const char* last = first + lexeme.size();
+        uint64_t magnitude = 0;
+        auto [digitsEnd, digitsError] = std::from_chars(first, last, magnitude);
+        uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1 : 0);
+        if (digitsError == std::errc() && digitsEnd == last && magnitude <= limit && !(negative && magnitude == 0)) {
+            int64_t value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+            return arena.make<NumberExpr>(value);
         }
-        
-        return std::make_unique<CompGeStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
 
-    std::unique_ptr<Stmt> compLeStatementBody(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else-if and else branches
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
-            }
+        double value = 0;
+        auto [end, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || end != last) {
+            throw std::runtime_error("Invalid number format");
         }
-        
-        return std::make_unique<CompLeStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
+        return arena.make<NumberExpr>(negative ? -value : value);
     }
 
-    std::unique_ptr<Stmt> compGStatementBody(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else-if and else branches
-        while (match({TokenType::ELSE})) {
-            // Check for 'else if'
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-
-                // Handle AND/OR conditions in else-if
-                auto condition = handleElseIfCondition();
-                if (condition) {
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), statement()));
-                }
-            } else {
-                elseBranch = statement();
-                break;
+    // Decodes the escape sequences the lexer left in a string lexeme
+    static std::string unescape(std::string_view lexeme) {
+        std::string value;
+        value.reserve(lexeme.size());
+        for (size_t i = 0; i < lexeme.size(); i++) {
+            if (lexeme[i] != '\\' || i + 1 == lexeme.size()) {
+                value += lexeme[i];
+                continue;
             }
-        }
-        
-        return std::make_unique<CompGStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
-    }
-
-    std::unique_ptr<Stmt> compLStatementBody(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
-        auto thenBranch = statement();
-        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> elseIfBranches;
-        std::unique_ptr<Stmt> elseBranch = nullptr;
-        
-        // Handle else-if and else branches
-        while (match({TokenType::ELSE})) {
-            if (peek().type == TokenType::IF) {
-                advance(); // consume 'if'
-                if (match({TokenType::COMPEQ})) {
-                    consume(TokenType::LEFT_PAREN, "Expect '(' after 'compeq'.");
-                    auto elseIfLeft = expression();
-                    consume(TokenType::COMMA, "Expect ',' after left operand.");
-                    auto elseIfRight = expression();
-                    consume(TokenType::RIGHT_PAREN, "Expect ')' after right operand.");
-                    auto elseIfBranch = statement();
-                    
-                    auto condition = std::make_unique<CompEqExpr>(std::move(elseIfLeft), std::move(elseIfRight));
-                    elseIfBranches.push_back(std::make_pair(std::move(condition), std::move(elseIfBranch)));
-                }
-            } else {
-                elseBranch = statement();
-                break;
+            switch (lexeme[++i]) {
+                case 'n': value += '\n'; break;  // Newline
+                case 't': value += '\t'; break;  // Tab
+                case 'r': value += '\r'; break;  // Carriage return
+                default: value += lexeme[i]; break; // \\, \", \' and anything else
             }
         }
-        
-        return std::make_unique<CompLStmt>(
-            std::move(left), 
-            std::move(right), 
-            std::move(thenBranch),
-            std::move(elseIfBranches),
-            std::move(elseBranch)
-        );
+        return value;
     }
 
     void error(const Token& token, const std::string& message) {
@@ -0,0 +1,76 @@
+// profiler.cpp
+
+#include "profiler.h"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sys/time.h>
+
+namespace {
+
+// CPU time between samples
+const long kIntervalMicros = 1000;
+
+std::string outputPath;
+std::map<std::string, size_t> stackCounts;  // Sorted, so the output is stable
+
+void onTimer(int) {
+    Profiler::pending = 1;
+}
+
+void setTimer(long micros) {
+    struct itimerval timer = {};
+    timer.it_interval.tv_usec = micros;
+    timer.it_value.tv_usec = micros;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+} // namespace
+
+void Profiler::start(const std::string& path) {
+    outputPath = path;
+    enabled = true;
+    frames.push_back(Frame{"script", 0});
+
+    struct sigaction action = {};
+    action.sa_handler = onTimer;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, nullptr);
+    setTimer(kIntervalMicros);
+}
+
+void Profiler::stop() {
+    if (!enabled) {
+        return;
+    }
+    setTimer(0);
+    enabled = false;
+    pending = 0;
+
+    std::ofstream out(outputPath);
+    if (!out) {
+        std::cerr << "Error: Could not write profile to " << outputPath << std::endl;
+        return;
+    }
+    for (const auto& [stack, count] : stackCounts) {
+        out << stack << ' ' << count << '\n';
+    }
+}
+
+void Profiler::sample(const std::vector<Frame>& stack) {
+    pending = 0;
+
+    std::string folded;
+    for (const Frame& frame : stack) {
+        if (!folded.empty()) {
+            folded += ';';
+        }
+        folded += frame.name;
+        if (frame.line > 0) {
+            folded += ':';
+            folded += std::to_string(frame.line);
+        }
+    }
+    stackCounts[folded]++;
+}
@@ -0,0 +1,74 @@
+// profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <csignal>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sampling profiler for --profile. A CPU-time timer signal only raises
+// 'pending'; the engines check it at safe points (the interpreter before
+// every statement, the VM at calls and loop back-edges) and record the
+// script-level call stack there, as function:line frames. Samples are
+// written in the folded format flamegraph.pl and speedscope read: one line
+// per distinct stack, frames joined by ';', then the sample count.
+//
+// While profiling is off the timer never fires, so the only cost is testing
+// a flag at those safe points.
+class Profiler
+{
+public:
+    struct Frame {
+        std::string_view name;
+        int line;  // Line running in this function, 0 if unknown
+    };
+
+    static inline volatile std::sig_atomic_t pending = 0;
+    static inline bool enabled = false;
+
+    // The interpreter's call stack; the VM reads its own frames instead
+    static inline std::vector<Frame> frames;
+
+    // Pushes an interpreted function's frame for the duration of the call
+    class Call {
+    public:
+        explicit Call(std::string_view name) : active(enabled) {
+            if (active) {
+                frames.push_back(Frame{name, 0});
+            }
+        }
+
+        ~Call() {
+            if (active) {
+                frames.pop_back();
+            }
+        }
+
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+
+    private:
+        bool active;
+    };
+
+    // The interpreter is about to run a statement on 'line'. Synthesized
+    // statements have no line and keep the enclosing one.
+    static void at(int line) {
+        if (line > 0) {
+            frames.back().line = line;
+        }
+        if (pending) {
+            sample(frames);
+        }
+    }
+
+    // Starts the timer; the samples go to 'path' when stop() is called
+    static void start(const std::string& path);
+    static void stop();
+
+    // Counts one sample of 'stack', outermost frame first
+    static void sample(const std::vector<Frame>& stack);
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,314 @@
+// resolver.h
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "visitor.h"
+#include "ast.h"
+#include "intern.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Static pass that runs after Parser::parse() and assigns every variable a
+// slot in the environment of the function scope that declares it. Blocks do
+// not open scopes, so each function call gets one flat environment and
+// 'depth' counts the function scopes between a use and its declaration.
+//
+// Within a function, names are declared in the order the statements appear,
+// so a use before the local 'var' still reaches the enclosing scope. Bodies
+// of nested functions are resolved once the enclosing body is complete,
+// which lets them call functions declared after them. Names that are not
+// declared in any function scope are globals.
+class Resolver : public Visitor
+{
+private:
+    struct Scope {
+        std::unordered_map<const ObjString*, int> slots;  // By interned name
+        std::vector<std::string> names;
+        std::vector<FunctionStmt*> deferred;
+        std::vector<bool> used;        // Slots read or assigned anywhere, by slot
+        std::vector<LoopStmt*> loops;  // Loops whose variable lives in this scope
+    };
+
+    Scope globals;
+    std::vector<Scope> scopes;
+
+public:
+    void resolve(const std::vector<StmtPtr>& statements) {
+        for (const auto& statement : statements) {
+            resolveStmt(statement);
+        }
+        resolveDeferred();
+    }
+
+    // Declares a global defined outside any script, such as a builtin
+    int declareGlobal(const std::string& name) {
+        int depth, slot;
+        lookup(name, depth, slot);
+        return slot;
+    }
+
+    // Global names indexed by slot
+    const std::vector<std::string>& globalNames() const {
+        return globals.names;
+    }
+
+    void visit(NumberExpr *expr) override {}
+    void visit(StringExpr *expr) override {}
+    void visit(BooleanExpr *expr) override {}
+
+    void visit(VariableExpr *expr) override {
+        lookup(expr->name.lexeme, expr->depth, expr->slot);
+    }
+
+    void visit(AssignExpr* expr) override {
+        resolveExpr(expr->value);
+        lookup(expr->name.lexeme, expr->depth, expr->slot);
+    }
+
+    void visit(BinaryExpr *expr) override {
+        resolveExpr(expr->left);
+        resolveExpr(expr->right);
+    }
+
+    void visit(CompEqExpr* expr) override {
+        resolveExpr(expr->left);
+        resolveExpr(expr->right);
+    }
+
+    void visit(ArrayExpr* expr) override {
+        for (const auto& element : expr->elements) {
+            resolveExpr(element);
+        }
+    }
+
+    void visit(FixedArrayExpr* expr) override {
+        for (const auto& element : expr->elements) {
+            resolveExpr(element);
+        }
+    }
+
+    void visit(MapExpr* expr) override {
+        for (size_t i = 0; i < expr->keys.size(); i++) {
+            resolveExpr(expr->keys[i]);
+            resolveExpr(expr->values[i]);
+        }
+    }
+
+    void visit(IndexExpr* expr) override {
+        resolveExpr(expr->object);
+        resolveExpr(expr->index);
+    }
+
+    void visit(AssignIndexExpr* expr) override {
+        resolveExpr(expr->object);
+        resolveExpr(expr->index);
+        resolveExpr(expr->value);
+    }
+
+    void visit(CallExpr* expr) override {
+        resolveExpr(expr->callee);
+        for (const auto& arg : expr->arguments) {
+            resolveExpr(arg);
+        }
+    }
+
+    void visit(PrintStmt *stmt) override {
+        resolveExpr(stmt->expression);
+    }
+
+    void visit(VarStmt *stmt) override {
+        // The initializer still sees any outer variable of the same name
+        if (stmt->initializer) {
+            resolveExpr(stmt->initializer);
+        }
+        stmt->slot = declare(stmt->name.lexeme);
+    }
+
+    void visit(InputStmt *stmt) override {
+        stmt->slot = declare(stmt->variableName.lexeme);
+    }
+
+    void visit(BlockStmt* stmt) override {
+        for (const auto& statement : stmt->statements) {
+            resolveStmt(statement);
+        }
+    }
+
+    void visit(LoopStmt* stmt) override {
+        resolveExpr(stmt->from);
+        resolveExpr(stmt->to);
+        if (stmt->step) {
+            resolveExpr(stmt->step);
+        }
+        stmt->slot = declare(stmt->var.lexeme);
+        currentScope().loops.push_back(stmt);
+        resolveStmt(stmt->body);
+    }
+
+    void visit(BreakStmt* stmt) override {}
+    void visit(ContinueStmt* stmt) override {}
+
+    void visit(ExpressionStmt* stmt) override {
+        resolveExpr(stmt->expression);
+    }
+
+    void visit(CompareStmt* stmt) override {
+        for (const auto& arm : stmt->arms) {
+            resolveExpr(arm.left);
+            resolveExpr(arm.right);
+            resolveStmt(arm.body);
+        }
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(AndStmt* stmt) override {
+        resolveExpr(stmt->left);
+        resolveExpr(stmt->right);
+        resolveStmt(stmt->thenBranch);
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(OrStmt* stmt) override {
+        resolveExpr(stmt->left);
+        resolveExpr(stmt->right);
+        resolveStmt(stmt->thenBranch);
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(NotStmt* stmt) override {
+        resolveExpr(stmt->operand);
+        resolveStmt(stmt->thenBranch);
+        for (const auto& branch : stmt->elseIfBranches) {
+            resolveExpr(branch.first);
+            resolveStmt(branch.second);
+        }
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(AndConditionStmt* stmt) override {
+        for (const auto& condition : stmt->conditions) {
+            resolveStmt(condition);
+        }
+        resolveStmt(stmt->thenBranch);
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(OrConditionStmt* stmt) override {
+        for (const auto& condition : stmt->conditions) {
+            resolveStmt(condition);
+        }
+        resolveStmt(stmt->thenBranch);
+        resolveStmt(stmt->elseBranch);
+    }
+
+    void visit(FunctionStmt* stmt) override {
+        stmt->slot = declare(stmt->name.lexeme);
+        currentScope().deferred.push_back(stmt);
+    }
+
+    void visit(ReturnStmt* stmt) override {
+        if (stmt->value) {
+            resolveExpr(stmt->value);
+        }
+    }
+
+private:
+    Scope& currentScope() {
+        return scopes.empty() ? globals : scopes.back();
+    }
+
+    void resolveExpr(const ExprPtr& expr) {
+        expr->accept(this);
+    }
+
+    void resolveStmt(const StmtPtr& stmt) {
+        if (stmt) {
+            stmt->accept(this);
+        }
+    }
+
+    void resolveDeferred() {
+        // Resolving a body pushes a scope, so fetch the current one each time
+        for (size_t i = 0; i < currentScope().deferred.size(); i++) {
+            resolveFunction(currentScope().deferred[i]);
+        }
+        currentScope().deferred.clear();
+    }
+
+    void resolveFunction(FunctionStmt* function) {
+        scopes.emplace_back();
+
+        // Parameters always occupy the first slots, in order
+        Scope& scope = scopes.back();
+        for (const auto& param : function->parameters) {
+            scope.slots[StringTable::intern(param.lexeme)] = static_cast<int>(scope.names.size());
+            scope.names.emplace_back(param.lexeme);
+        }
+
+        for (const auto& statement : function->body) {
+            resolveStmt(statement);
+        }
+        resolveDeferred();
+
+        // Every use of a function's locals is known once its body and nested
+        // functions are resolved. Globals stay visible to later REPL lines, so
+        // global loop variables are always kept.
+        Scope& finished = scopes.back();
+        for (LoopStmt* loop : finished.loops) {
+            size_t slot = static_cast<size_t>(loop->slot);
+            loop->varUsed = slot < finished.used.size() && finished.used[slot];
+        }
+
+        function->localNames = std::move(finished.names);
+        scopes.pop_back();
+    }
+
+    static void markUsed(Scope& scope, int slot) {
+        if (scope.used.size() <= static_cast<size_t>(slot)) {
+            scope.used.resize(slot + 1);
+        }
+        scope.used[slot] = true;
+    }
+
+    int declare(std::string_view lexeme) {
+        const ObjString* name = StringTable::intern(lexeme);
+        Scope& scope = currentScope();
+        auto it = scope.slots.find(name);
+        if (it != scope.slots.end()) {
+            return it->second;
+        }
+        int slot = static_cast<int>(scope.names.size());
+        scope.slots[name] = slot;
+        scope.names.emplace_back(lexeme);
+        return slot;
+    }
+
+    void lookup(std::string_view lexeme, int& depth, int& slot) {
+        const ObjString* name = StringTable::intern(lexeme);
+        for (size_t i = scopes.size(); i > 0; i--) {
+            auto it = scopes[i - 1].slots.find(name);
+            if (it != scopes[i - 1].slots.end()) {
+                depth = static_cast<int>(scopes.size() - i);
+                slot = it->second;
+                markUsed(scopes[i - 1], slot);
+                return;
+            }
+        }
+
+        // Not declared in any function: a global, possibly one defined later
+        depth = static_cast<int>(scopes.size());
+        auto it = globals.slots.find(name);
+        if (it != globals.slots.end()) {
+            slot = it->second;
+            return;
+        }
+        slot = static_cast<int>(globals.names.size());
+        globals.slots[name] = slot;
+        globals.names.emplace_back(lexeme);
+    }
+};
+
+#endif // RESOLVER_H
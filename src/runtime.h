@@ -0,0 +1,439 @@
+// runtime.h
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include "environment.h"
+#include "map.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// Value helpers shared by the tree-walking Interpreter and the bytecode VM
+
+// Helper for converting any value to a string
+inline std::string valueToString(const Value& value) {
+    if (isString(value)) {
+        return asString(value);
+    } else if (isNumber(value)) {
+        char digits[24];
+        if (value.isInteger()) {
+            return std::string(digits, std::to_chars(digits, digits + sizeof(digits), value.integer()).ptr);
+        }
+        double num = asNumber(value);
+        if (num == std::trunc(num) && std::fabs(num) < 9.2e18) {
+            // It's a whole number, remove decimal part
+            return std::string(digits, std::to_chars(digits, digits + sizeof(digits), static_cast<int64_t>(num)).ptr);
+        } else {
+            // Format with precision to avoid trailing zeros
+            std::ostringstream ss;
+            ss << std::fixed << std::setprecision(15) << num;
+            std::string str = ss.str();
+            // Remove trailing zeros
+            str = str.substr(0, str.find_last_not_of('0') + 1);
+            // Remove trailing decimal point if needed
+            if (str.back() == '.') str.pop_back();
+            return str;
+        }
+    } else if (isBoolean(value)) {
+        return asBoolean(value) ? "true" : "false";
+    } else if (isArray(value)) {
+        // Create string representation of array
+        std::string result = "[";
+        const auto& array = asArray(value);
+        for (size_t i = 0; i < array.size(); i++) {
+            result += valueToString(array.get(i));
+            if (i < array.size() - 1) {
+                result += ", ";
+            }
+        }
+        result += "]";
+        return result;
+    } else if (isMap(value)) {
+        std::string result = "{";
+        bool first = true;
+        for (const auto& entry : asMap(value).entries()) {
+            if (entry.key.isUndefined()) {
+                continue;
+            }
+            if (!first) {
+                result += ", ";
+            }
+            first = false;
+            result += valueToString(entry.key) + ": " + valueToString(entry.value);
+        }
+        result += "}";
+        return result;
+    }
+    return "nil";
+}
+
+// String concatenation for '+' when at least one operand is a string; the
+// other operand is converted to its string form
+inline Value concatenate(const Value& left, const Value& right) {
+    auto toObjString = [](const Value& value) {
+        if (isString(value)) {
+            return Ref<ObjString>(static_cast<ObjString*>(value.object()));
+        }
+        return makeRef<ObjString>(valueToString(value));
+    };
+    return makeString(toObjString(left), toObjString(right));
+}
+
+// Array concatenation for '+'. The result appends to the left operand's
+// buffer when it can, so 'a = a + [x]' takes amortized constant time.
+inline Value concatenateArrays(const ObjArray& left, const ObjArray& right) {
+    return Value(Value::Type::ARRAY, new ObjArray(left, right));
+}
+
+// Number arithmetic. Two integers give an integer unless the result
+// overflows 64 bits, in which case it is computed in doubles like any
+// other operands. Callers check that both operands are numbers.
+inline Value addNumbers(const Value& left, const Value& right) {
+    int64_t sum;
+    if (left.isInteger() && right.isInteger() && !__builtin_add_overflow(left.integer(), right.integer(), &sum)) {
+        return makeInteger(sum);
+    }
+    return makeNumber(left.number() + right.number());
+}
+
+inline Value subtractNumbers(const Value& left, const Value& right) {
+    int64_t difference;
+    if (left.isInteger() && right.isInteger() && !__builtin_sub_overflow(left.integer(), right.integer(), &difference)) {
+        return makeInteger(difference);
+    }
+    return makeNumber(left.number() - right.number());
+}
+
+inline Value multiplyNumbers(const Value& left, const Value& right) {
+    int64_t product;
+    if (left.isInteger() && right.isInteger() && !__builtin_mul_overflow(left.integer(), right.integer(), &product)) {
+        // 0 * -x is -0 in doubles
+        if (product != 0 || (left.integer() >= 0 && right.integer() >= 0) ||
+            (left.integer() <= 0 && right.integer() <= 0)) {
+            return makeInteger(product);
+        }
+    }
+    return makeNumber(left.number() * right.number());
+}
+
+// The right operand must not be zero. The result takes the sign of the
+// left operand, as fmod does.
+inline Value moduloNumbers(const Value& left, const Value& right) {
+    if (left.isInteger() && right.isInteger()) {
+        int64_t a = left.integer();
+        int64_t b = right.integer();
+        int64_t remainder = b == -1 ? 0 : a % b;  // INT64_MIN % -1 traps
+        if (remainder != 0 || a >= 0) {
+            return makeInteger(remainder);
+        }
+    }
+    return makeNumber(std::fmod(left.number(), right.number()));
+}
+
+// Helper for boolean equality comparison
+inline bool isEqual(const Value& a, const Value& b) {
+    // Different types are never equal
+    if (a.type() != b.type()) return false;
+
+    // Check if they're the same object
+    if (a.isObject() && a.object() == b.object()) return true;
+
+    // Same type comparison
+    switch (a.type()) {
+        case Value::Type::NUMBER:
+            return sameNumber(a, b);
+        case Value::Type::STRING:
+            // Distinct interned strings always differ
+            if (static_cast<ObjString*>(a.object())->interned && static_cast<ObjString*>(b.object())->interned) return false;
+            return asString(a) == asString(b);
+        case Value::Type::BOOLEAN:
+            return asBoolean(a) == asBoolean(b);
+        case Value::Type::ARRAY: {
+            const auto& arrayA = asArray(a);
+            const auto& arrayB = asArray(b);
+
+            // Different lengths means different arrays
+            if (arrayA.size() != arrayB.size()) return false;
+
+            if (arrayA.isPacked() && arrayB.isPacked()) {
+                return std::equal(arrayA.numberData(), arrayA.numberData() + arrayA.size(), arrayB.numberData());
+            }
+
+            // Compare each element
+            for (size_t i = 0; i < arrayA.size(); i++) {
+                if (!isEqual(arrayA.get(i), arrayB.get(i))) return false;
+            }
+            return true;
+        }
+        case Value::Type::MAP: {
+            const ObjMap& mapA = asMap(a);
+            const ObjMap& mapB = asMap(b);
+            if (mapA.size() != mapB.size()) return false;
+
+            // Same keys, each with an equal value
+            for (const auto& entry : mapA.entries()) {
+                if (entry.key.isUndefined()) continue;
+                const Value* other = mapB.find(entry.key);
+                if (other == nullptr || !isEqual(entry.value, *other)) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// The test made by each compare-and-branch statement (compeq, compg, ...)
+enum class Comparison : uint8_t {
+    EQUAL,
+    NOT_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL
+};
+
+// Decides a compare-and-branch statement without building a boolean Value.
+// Equality accepts any operands; ordering needs two numbers or two strings.
+inline bool compareValues(Comparison op, const Value& left, const Value& right) {
+    if (left.isInteger() && right.isInteger()) {
+        int64_t a = left.integer();
+        int64_t b = right.integer();
+        switch (op) {
+            case Comparison::EQUAL: return a == b;
+            case Comparison::NOT_EQUAL: return a != b;
+            case Comparison::GREATER: return a > b;
+            case Comparison::GREATER_EQUAL: return a >= b;
+            case Comparison::LESS: return a < b;
+            default: return a <= b;
+        }
+    }
+    if (isNumber(left) && isNumber(right) && (left.isInteger() || right.isInteger())) {
+        int order = numberOrder(left, right);
+        switch (op) {
+            case Comparison::EQUAL: return order == 0;
+            case Comparison::NOT_EQUAL: return order != 0;
+            case Comparison::GREATER: return order == 1;
+            case Comparison::GREATER_EQUAL: return order == 1 || order == 0;
+            case Comparison::LESS: return order == -1;
+            default: return order == -1 || order == 0;
+        }
+    }
+    if (isNumber(left) && isNumber(right)) {
+        double a = asNumber(left);
+        double b = asNumber(right);
+        switch (op) {
+            case Comparison::EQUAL: return a == b;
+            case Comparison::NOT_EQUAL: return a != b;
+            case Comparison::GREATER: return a > b;
+            case Comparison::GREATER_EQUAL: return a >= b;
+            case Comparison::LESS: return a < b;
+            default: return a <= b;
+        }
+    }
+    if (op == Comparison::EQUAL) {
+        return isEqual(left, right);
+    }
+    if (op == Comparison::NOT_EQUAL) {
+        return !isEqual(left, right);
+    }
+    if (isString(left) && isString(right)) {
+        int order = asString(left).compare(asString(right));
+        switch (op) {
+            case Comparison::GREATER: return order > 0;
+            case Comparison::GREATER_EQUAL: return order >= 0;
+            case Comparison::LESS: return order < 0;
+            default: return order <= 0;
+        }
+    }
+    throw std::runtime_error("Operands must be two numbers or two strings.");
+}
+
+// Whether a counting loop's counter has gone past 'to'
+inline bool loopFinished(bool down, const Value& counter, const Value& to) {
+    if (counter.isInteger() && to.isInteger()) {
+        return down ? counter.integer() < to.integer() : counter.integer() > to.integer();
+    }
+    return compareValues(down ? Comparison::LESS : Comparison::GREATER, counter, to);
+}
+
+// Helper to check if a value is truthy
+inline bool isTruthy(const Value& value) {
+    if (isBoolean(value)) { // boolean
+        return asBoolean(value);
+    } else if (isNumber(value)) { // number
+        return asNumber(value) != 0.0;
+    } else if (isString(value)) { // string
+        return !asString(value).empty();
+    } else if (isArray(value)) { // array
+        return !asArray(value).empty();
+    } else if (isMap(value)) {
+        return !asMap(value).empty();
+    }
+    return false;
+}
+
+// The element 'index' names in 'array'. Integers are used as they are;
+// other numbers are truncated toward zero.
+inline size_t arrayIndex(const ObjArray& array, const Value& index) {
+    int64_t idx;
+    if (index.isInteger()) {
+        idx = index.integer();
+    } else {
+        double number = index.number();
+        idx = number > -9.2e18 && number < 9.2e18 ? static_cast<int64_t>(number) : -1;
+    }
+
+    // Check bounds
+    if (idx < 0 || static_cast<uint64_t>(idx) >= array.size()) {
+        Value shown = index.isInteger() ? index : makeNumberOrInteger(std::trunc(index.number()));
+        throw std::runtime_error("Array index out of bounds: " + valueToString(shown));
+    }
+    return static_cast<size_t>(idx);
+}
+
+// object[index] for arrays and maps
+inline Value indexValue(const Value& object, const Value& index) {
+    if (isMap(object)) {
+        const Value* value = asMap(object).find(index);
+        if (value == nullptr) {
+            throw std::runtime_error("Key not found in map: " + valueToString(index));
+        }
+        return *value;
+    }
+
+    // Make sure we're indexing an array
+    if (!isArray(object)) {
+        throw std::runtime_error("Cannot index a non-array value");
+    }
+
+    // Make sure the index is a number
+    if (!isNumber(index)) {
+        throw std::runtime_error("Array index must be a number");
+    }
+
+    const auto& array = asArray(object);
+    size_t idx = arrayIndex(array, index);
+    return array.get(idx);
+}
+
+// object[index] = value for arrays and maps; maps gain missing keys
+inline void assignIndex(const Value& object, const Value& index, Value value) {
+    if (isMap(object)) {
+        asMap(object).set(index, std::move(value));
+        return;
+    }
+
+    if (!isArray(object)) {
+        throw std::runtime_error("Cannot index a non-array value");
+    }
+    if (!isNumber(index)) {
+        throw std::runtime_error("Array index must be a number");
+    }
+
+    auto& array = asArray(object);
+    array.set(arrayIndex(array, index), std::move(value));
+}
+
+// Convert a line typed at an 'input' statement into a value
+inline Value parseInputValue(const std::string& input) {
+    // Try to convert to number, but handle errors properly
+    try {
+        size_t pos;
+        double value = std::stod(input, &pos);
+
+        // Check if the entire string was converted
+        if (pos == input.length()) {
+            return makeNumberOrInteger(value);
+        }
+
+        // Check for boolean values
+        if (input == "true") {
+            return makeBoolean(true);
+        } else if (input == "false") {
+            return makeBoolean(false);
+        } else if (input.front() == '[' && input.back() == ']') {
+            // Basic array parsing for input (simple format)
+            std::vector<Value> array;
+            // Parse a simple comma-separated list of values
+            std::string contents = input.substr(1, input.length() - 2);
+            std::istringstream ss(contents);
+            std::string item;
+
+            while (std::getline(ss, item, ',')) {
+                // Trim spaces
+                item.erase(0, item.find_first_not_of(" \t"));
+                item.erase(item.find_last_not_of(" \t") + 1);
+
+                // Try to parse as number, boolean, or string
+                if (item == "true") {
+                    array.push_back(makeBoolean(true));
+                } else if (item == "false") {
+                    array.push_back(makeBoolean(false));
+                } else {
+                    try {
+                        size_t pos;
+                        double num = std::stod(item, &pos);
+                        if (pos == item.length()) {
+                            array.push_back(makeNumberOrInteger(num));
+                        } else {
+                            array.push_back(makeString(item));
+                        }
+                    } catch (const std::exception&) {
+                        array.push_back(makeString(item));
+                    }
+                }
+            }
+
+            return makeArray(std::move(array));
+        }
+        return makeString(input);
+    }
+    catch (const std::invalid_argument&) {
+        // Check for boolean values
+        if (input == "true") {
+            return makeBoolean(true);
+        } else if (input == "false") {
+            return makeBoolean(false);
+        } else if (!input.empty() && input.front() == '[' && input.back() == ']') {
+            // Basic array parsing
+            std::vector<Value> array;
+            // Very simple parsing - split by commas
+            std::string contents = input.substr(1, input.length() - 2);
+            std::istringstream ss(contents);
+            std::string item;
+
+            while (std::getline(ss, item, ',')) {
+                // Trim spaces
+                item.erase(0, item.find_first_not_of(" \t"));
+                item.erase(item.find_last_not_of(" \t") + 1);
+
+                // Just store everything as strings in this basic version
+                array.push_back(makeString(item));
+            }
+
+            return makeArray(std::move(array));
+        }
+        // Not a number or boolean, treat as string
+        return makeString(input);
+    }
+    catch (const std::out_of_range&) {
+        // Number out of range
+        std::cerr << "Warning: Number out of range, treating as string" << std::endl;
+        return makeString(input);
+    }
+}
+
+// Read one line from stdin for an 'input' statement
+inline Value readInputValue() {
+    std::string input;
+    std::getline(std::cin, input);
+    return parseInputValue(input);
+}
+
+#endif // RUNTIME_H
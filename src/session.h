@@ -0,0 +1,125 @@
+// session.h
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "interpreter.h"
+#include "compiler.h"
+#include "vm.h"
+#include "builtins.h"
+#include "gc.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// State shared by every input of one program run. The REPL feeds each line to
+// the same Session, so globals, functions and the resolver's global symbol
+// table carry over and each line is compiled against what came before.
+class Session
+{
+public:
+    // 'optimize' runs the Optimizer over every input before it executes
+    Session(bool useInterpreter, bool optimize) : useInterpreter(useInterpreter), optimize(optimize) {
+        for (const auto& builtin : builtins()) {
+            int slot = resolver.declareGlobal(builtin.name);
+            Value function = makeFunction(new NativeFunction(builtin.name, builtin.arity, builtin.implementation));
+            interpreter.environment->define(slot, function);
+            vm.defineGlobal(slot, function);
+        }
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    void run(std::unique_ptr<SourceBuffer> source) {
+        try {
+            std::vector<StmtPtr> statements = parse(std::move(source));
+            if (useInterpreter) {
+                Stats::Timer timer(Stats::run);
+                interpreter.interpret(statements);
+            } else {
+                auto script = compile(statements);
+                Stats::Timer timer(Stats::run);
+                vm.interpret(script);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        CycleCollector::maybeCollect();
+    }
+
+    // Compiles a source for the VM without running it. Returns null and
+    // reports the error if compilation fails.
+    std::shared_ptr<FunctionProto> compile(std::unique_ptr<SourceBuffer> source) {
+        try {
+            return compile(parse(std::move(source)));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Runs a script that was compiled earlier, possibly by another process
+    void run(const std::shared_ptr<FunctionProto>& script) {
+        {
+            Stats::Timer timer(Stats::run);
+            vm.interpret(script);
+        }
+        CycleCollector::maybeCollect();
+    }
+
+private:
+    bool useInterpreter;
+    bool optimize;
+    std::vector<std::unique_ptr<SourceBuffer>> sources;
+    std::vector<std::unique_ptr<AstArena>> arenas;
+    Resolver resolver;
+    Interpreter interpreter;
+    VM vm;
+
+    std::vector<StmtPtr> parse(std::unique_ptr<SourceBuffer> source) {
+        // Tokens and AST nodes point into the source, and interpreted
+        // functions into the AST, so both are kept for the whole session
+        sources.push_back(std::move(source));
+        arenas.push_back(std::make_unique<AstArena>());
+
+        std::vector<Token> tokens;
+        {
+            Stats::Timer timer(Stats::lex);
+            Lexer lexer(sources.back()->text());
+            tokens = lexer.lex();
+        }
+        Stats::tokens += tokens.size();
+
+        std::vector<StmtPtr> statements;
+        {
+            Stats::Timer timer(Stats::parse);
+            Parser parser(tokens, *arenas.back());
+            statements = parser.parse();
+        }
+
+        {
+            Stats::Timer timer(Stats::resolve);
+            resolver.resolve(statements);
+        }
+        if (optimize) {
+            Stats::Timer timer(Stats::optimize);
+            Optimizer optimizer(*arenas.back());
+            optimizer.optimize(statements);
+        }
+        Stats::astNodes += arenas.back()->size();
+        return statements;
+    }
+
+    std::shared_ptr<FunctionProto> compile(const std::vector<StmtPtr>& statements) {
+        Stats::Timer timer(Stats::compile);
+        Compiler compiler;
+        return compiler.compile(statements, resolver.globalNames());
+    }
+};
+
+#endif // SESSION_H
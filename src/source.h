@@ -0,0 +1,83 @@
+// source.h
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only text of a script. Regular files are memory-mapped so tokens can
+// point straight into the file; anything else is read into memory.
+class SourceBuffer
+{
+public:
+    SourceBuffer() = default;
+    explicit SourceBuffer(std::string text) : owned(std::move(text)), view(owned) {}
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    ~SourceBuffer() {
+        unmap();
+    }
+
+    // Returns false if the file cannot be opened
+    bool open(const std::string& filename) {
+        unmap();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                ::close(fd);
+                mapped = data;
+                mappedSize = info.st_size;
+                view = std::string_view(static_cast<const char*>(data), mappedSize);
+                return true;
+            }
+        }
+        ::close(fd);
+
+        // Pipes, devices, empty files, or mmap failure
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        owned = buffer.str();
+        view = owned;
+        return true;
+    }
+
+    std::string_view text() const {
+        return view;
+    }
+
+private:
+    std::string owned;
+    void* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::string_view view;
+
+    void unmap() {
+        if (mapped != nullptr) {
+            munmap(mapped, mappedSize);
+            mapped = nullptr;
+            mappedSize = 0;
+        }
+        view = owned;
+    }
+};
+
+#endif // SOURCE_H
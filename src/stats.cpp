@@ -0,0 +1,71 @@
+// stats.cpp
+
+#include "stats.h"
+#include <iomanip>
+#include <sys/resource.h>
+
+namespace {
+
+// Largest resident set of the process so far; Linux reports kilobytes
+size_t peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+} // namespace
+
+void Stats::report(std::ostream& out, bool json) {
+    const Phase* phases[] = {&lex, &parse, &resolve, &optimize, &compile, &cache, &run};
+    struct Counter {
+        const char* name;
+        size_t value;
+    };
+    const Counter counters[] = {
+        {"tokens", tokens},
+        {"ast_nodes", astNodes},
+        {"objects", objects},
+        {"strings", strings},
+        {"environments", environments},
+        {"peak_object_bytes", peakObjectBytes},
+        {"peak_rss_bytes", peakResidentBytes()},
+        {"calls", calls},
+        {"native_calls", nativeCalls},
+        {"collections", collections},
+    };
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(6);
+
+    if (json) {
+        out << "{\"phases\": {";
+        const char* separator = "";
+        for (const Phase* phase : phases) {
+            out << separator << "\"" << phase->name << "\": {\"wall\": " << phase->wallSeconds
+                << ", \"cpu\": " << phase->cpuSeconds << "}";
+            separator = ", ";
+        }
+        out << "}";
+        for (const Counter& counter : counters) {
+            out << ", \"" << counter.name << "\": " << counter.value;
+        }
+        out << "}" << std::endl;
+    } else {
+        out << "phase          wall ms     cpu ms" << std::endl;
+        out << std::setprecision(3);
+        for (const Phase* phase : phases) {
+            out << std::left << std::setw(10) << phase->name << std::right
+                << std::setw(12) << phase->wallSeconds * 1000
+                << std::setw(11) << phase->cpuSeconds * 1000 << std::endl;
+        }
+        for (const Counter& counter : counters) {
+            out << std::left << std::setw(18) << counter.name << std::right << counter.value << std::endl;
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
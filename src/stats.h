@@ -0,0 +1,82 @@
+// stats.h
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <ostream>
+
+// Counters and phase timings for --stats. The counters are plain integers
+// bumped where the events happen and are always on; they cost about as much
+// as the reference counts next to them.
+class Stats
+{
+public:
+    // Wall-clock and CPU time spent in one phase, summed over every input
+    struct Phase {
+        const char* name;
+        double wallSeconds;
+        double cpuSeconds;
+    };
+
+    // Adds the time until it goes out of scope to a phase
+    class Timer {
+    public:
+        explicit Timer(Phase& phase)
+            : phase(phase), wallStart(std::chrono::steady_clock::now()), cpuStart(std::clock()) {}
+
+        ~Timer() {
+            std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wallStart;
+            phase.wallSeconds += wall.count();
+            phase.cpuSeconds += static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Phase& phase;
+        std::chrono::steady_clock::time_point wallStart;
+        std::clock_t cpuStart;
+    };
+
+    static inline Phase lex{"lex", 0, 0};
+    static inline Phase parse{"parse", 0, 0};
+    static inline Phase resolve{"resolve", 0, 0};
+    static inline Phase optimize{"optimize", 0, 0};
+    static inline Phase compile{"compile", 0, 0};
+    static inline Phase cache{"cache", 0, 0};  // Loading and saving .axc files
+    static inline Phase run{"run", 0, 0};
+
+    static inline size_t tokens = 0;
+    static inline size_t astNodes = 0;
+
+    // Heap objects: every string, array, map, function and environment
+    static inline size_t objects = 0;
+    static inline size_t objectBytes = 0;      // Live, counting each object's own size only
+    static inline size_t peakObjectBytes = 0;
+    static inline size_t strings = 0;
+    static inline size_t environments = 0;
+
+    static inline size_t calls = 0;        // Script functions
+    static inline size_t nativeCalls = 0;  // Builtins
+    static inline size_t collections = 0;
+
+    static void allocated(size_t size) {
+        objects++;
+        objectBytes += size;
+        if (objectBytes > peakObjectBytes) {
+            peakObjectBytes = objectBytes;
+        }
+    }
+
+    static void freed(size_t size) {
+        objectBytes -= size;
+    }
+
+    // Human-readable, or a single JSON object if 'json' is set
+    static void report(std::ostream& out, bool json);
+};
+
+#endif // STATS_H
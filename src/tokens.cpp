@@ -20,6 +20,7 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::SLASH: return "/";
         case TokenType::STAR: return "*";
         case TokenType::PERCENT: return "%";
+        case TokenType::COLON: return ":";
         case TokenType::BANG: return "!";
         case TokenType::BANG_EQUAL: return "!=";
         case TokenType::EQUAL: return "=";
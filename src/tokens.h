@@ -3,7 +3,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <string>   
+#include <string>
+#include <string_view>
 
 enum class TokenType {
     // Single character tokens
@@ -11,6 +12,7 @@ enum class TokenType {
     LEFT_BRACKET, RIGHT_BRACKET, // Added for array support
     LEFT_CURLY, RIGHT_CURLY, // Added for fixed size array initialization
     COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, STAR, PERCENT, // Added PERCENT
+    COLON, // Separates keys from values in map literals
     
     // One or two character tokens
     INPUT, BANG, BANG_EQUAL, EQUAL, EQUAL_EQUAL,
@@ -31,16 +33,17 @@ enum class TokenType {
     EOF_TOKEN
 };
 
+// A token's lexeme is a view into the source text, which must outlive the
+// tokens and the AST built from them. String lexemes exclude the quotes and
+// still contain their escape sequences.
 struct Token {
     TokenType type;
-    std::string lexeme;
-    std::string literal;  
+    std::string_view lexeme;
     int line;
 
     Token(TokenType type = TokenType::EOF_TOKEN, 
-          std::string lexeme = "", 
-          std::string literal = "",
-          int line = 1) : type(type), lexeme(lexeme), literal(literal), line(line) {}
+          std::string_view lexeme = {}, 
+          int line = 1) : type(type), lexeme(lexeme), line(line) {}
 };
 
 std::string tokenTypeToString(TokenType type);
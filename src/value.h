@@ -0,0 +1,719 @@
+// value.h
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "alloc.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Base of every heap-allocated value. Objects are reference counted by the
+// Values that point at them; the interpreter is single threaded, so the
+// count is a plain integer.
+struct Obj {
+    uint32_t refCount = 0;
+
+    virtual ~Obj() = default;
+
+    static void* operator new(size_t size) {
+        Stats::allocated(size);
+        return ObjAllocator::allocate(size);
+    }
+
+    // The destructor is virtual, so 'size' is that of the most derived type
+    static void operator delete(void* pointer, size_t size) {
+        Stats::freed(size);
+        ObjAllocator::deallocate(pointer, size);
+    }
+};
+
+inline void retainObj(Obj* object) {
+    object->refCount++;
+}
+
+inline void releaseObj(Obj* object) {
+    if (--object->refCount == 0) {
+        delete object;
+    }
+}
+
+class Value;
+struct Container;
+
+// Receives the references a Container holds, see Container::trace()
+class Tracer {
+public:
+    virtual ~Tracer() = default;
+    virtual void visit(Container* container) = 0;
+    inline void visit(const Value& value);
+};
+
+// An object that can refer to other objects: arrays, maps, functions and
+// environments. Reference counting alone never frees a cycle of these, so
+// every live Container is kept on a list the CycleCollector walks.
+struct Container : Obj {
+    Container() {
+        gcNext = head;
+        if (head != nullptr) {
+            head->gcPrev = this;
+        }
+        head = this;
+        liveCount++;
+        allocations++;
+    }
+
+    ~Container() override {
+        if (gcPrev != nullptr) {
+            gcPrev->gcNext = gcNext;
+        } else {
+            head = gcNext;
+        }
+        if (gcNext != nullptr) {
+            gcNext->gcPrev = gcPrev;
+        }
+        liveCount--;
+    }
+
+    // Report every Container this one references
+    virtual void trace(Tracer& tracer) {}
+
+    // Drop every reference, to break a cycle found to be garbage
+    virtual void clearReferences() {}
+
+    static Container* head;
+    static size_t liveCount;
+    static size_t allocations;  // Since the last collection
+
+    Container* gcPrev = nullptr;
+    Container* gcNext = nullptr;
+    int64_t gcRefs = 0;  // Scratch space for the collector
+};
+
+inline Container* Container::head = nullptr;
+inline size_t Container::liveCount = 0;
+inline size_t Container::allocations = 0;
+
+// Owning pointer to a reference-counted object that is not held in a Value
+template <typename T>
+class Ref {
+public:
+    Ref() : object(nullptr) {}
+    Ref(T* object) : object(object) {
+        if (object != nullptr) retainObj(object);
+    }
+    Ref(const Ref& other) : Ref(other.object) {}
+    Ref(Ref&& other) noexcept : object(other.object) {
+        other.object = nullptr;
+    }
+    ~Ref() {
+        if (object != nullptr) releaseObj(object);
+    }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(object, other.object);
+        return *this;
+    }
+
+    T* get() const { return object; }
+    T* operator->() const { return object; }
+    T& operator*() const { return *object; }
+    explicit operator bool() const { return object != nullptr; }
+
+private:
+    T* object;
+};
+
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+// A string. Concatenating long strings builds a rope node that keeps the two
+// halves and only copies them into one buffer when the text is first needed,
+// so appending to a string in a loop does not copy it every time.
+struct ObjString : Obj {
+    bool interned = false;  // Owned by the StringTable, see intern.h
+
+    explicit ObjString(std::string text) : text(std::move(text)), length(this->text.size()) {
+        Stats::strings++;
+    }
+
+    ObjString(Ref<ObjString> left, Ref<ObjString> right) : length(left->size() + right->size()) {
+        Stats::strings++;
+        if (length <= kFlatConcat) {
+            text = left->str() + right->str();
+        } else {
+            this->left = std::move(left);
+            this->right = std::move(right);
+        }
+    }
+
+    ~ObjString() override {
+        dropChildren();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // The text, flattening the rope first if needed
+    const std::string& str() {
+        if (left) {
+            flatten();
+        }
+        return text;
+    }
+
+    // 64-bit FNV-1a of the text, computed on first use
+    uint64_t hash() {
+        if (!hashed) {
+            hashValue = 14695981039346656037ull;
+            for (char c : str()) {
+                hashValue ^= static_cast<uint8_t>(c);
+                hashValue *= 1099511628211ull;
+            }
+            hashed = true;
+        }
+        return hashValue;
+    }
+
+private:
+    // Shorter results are copied straight away
+    static constexpr size_t kFlatConcat = 64;
+
+    std::string text;
+    Ref<ObjString> left;   // Both set while this is an unflattened rope
+    Ref<ObjString> right;
+    size_t length;
+    uint64_t hashValue = 0;
+    bool hashed = false;
+
+    void flatten() {
+        std::string flat;
+        flat.reserve(length);
+
+        // Visit the leaves left to right; ropes built by appending are deep,
+        // so use an explicit stack rather than recursion
+        std::vector<ObjString*> pending = {right.get(), left.get()};
+        while (!pending.empty()) {
+            ObjString* node = pending.back();
+            pending.pop_back();
+            if (node->left) {
+                pending.push_back(node->right.get());
+                pending.push_back(node->left.get());
+            } else {
+                flat += node->text;
+            }
+        }
+
+        text = std::move(flat);
+        dropChildren();
+    }
+
+    // Releases the halves without recursing down a long chain of ropes
+    void dropChildren() {
+        if (!left) {
+            return;
+        }
+        std::vector<Ref<ObjString>> pending;
+        pending.push_back(std::move(left));
+        pending.push_back(std::move(right));
+        while (!pending.empty()) {
+            Ref<ObjString> node = std::move(pending.back());
+            pending.pop_back();
+            if (node->refCount == 1 && node->left) {
+                pending.push_back(std::move(node->left));
+                pending.push_back(std::move(node->right));
+            }
+        }
+    }
+};
+
+// Storage for the elements of arrays. An array made by concatenation shares
+// the buffer of its left operand and appends to it in place, so building an
+// array one piece at a time does not copy it every step. Each array sees only
+// the first size() elements, and copies a shared buffer before writing to it.
+struct NumberBuffer : Obj {
+    std::vector<double> items;
+};
+
+// Values can refer to Containers, so this buffer is one too
+struct ValueBuffer : Container {
+    std::vector<Value> items;
+
+    void trace(Tracer& tracer) override;
+    void clearReferences() override;
+};
+
+// An array. While it holds only numbers of one kind they are packed into a
+// buffer of doubles, which the array builtins can process with SIMD; a flag
+// says whether they are integers. Storing anything else, including an
+// integer a double cannot hold exactly, switches it to a buffer of Values
+// for good.
+struct ObjArray : Container {
+    explicit ObjArray(std::vector<Value> elements);
+    explicit ObjArray(std::vector<double> numbers, bool integers = false);
+
+    // Concatenation: left's elements followed by right's
+    ObjArray(const ObjArray& left, const ObjArray& right);
+
+    size_t size() const {
+        return length;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    bool isPacked() const {
+        return static_cast<bool>(numbers);
+    }
+
+    // Whether the packed elements are integers; only valid while isPacked()
+    bool packsIntegers() const {
+        return integers;
+    }
+
+    // The packed elements; only valid while isPacked()
+    const double* numberData() const {
+        return numbers->items.data();
+    }
+
+    // Integers up to 2^53 either way are exact as doubles, so they can be packed
+    static bool packsExactly(int64_t integer) {
+        const int64_t kMaxExact = int64_t(1) << 53;
+        return integer >= -kMaxExact && integer <= kMaxExact;
+    }
+
+    inline Value get(size_t index) const;
+    inline void set(size_t index, Value value);
+    inline void append(Value value);
+
+    // Removes and returns the last element; the array must not be empty
+    inline Value removeLast();
+
+    // Grow with zeros or shrink to 'size' elements
+    inline void resize(size_t size);
+
+    void trace(Tracer& tracer) override;
+    void clearReferences() override;
+
+private:
+    Ref<NumberBuffer> numbers;   // Exactly one of the two is set
+    Ref<ValueBuffer> elements;
+    size_t length = 0;
+    bool integers = false;       // The packed elements are integers
+
+    inline bool packable(const Value& value) const;
+    inline void unpack();
+    inline void ownBuffer();
+    inline void ownBufferEnd();
+
+    // Room for 'count' more items, growing geometrically like push_back
+    template <typename T>
+    static void reserveFor(std::vector<T>& items, size_t count) {
+        if (items.size() + count > items.capacity()) {
+            items.reserve(std::max(items.capacity() * 2, items.size() + count));
+        }
+    }
+};
+
+// A 16-byte tagged value. Numbers and booleans are stored inline; strings,
+// arrays, functions and maps point to a reference-counted Obj. A NUMBER
+// holds either a double or, when its tag says so, an exact 64-bit integer;
+// number() reads both.
+class Value {
+public:
+    enum class Type : uint8_t { UNDEFINED, NUMBER, BOOLEAN, STRING, ARRAY, FUNCTION, MAP };
+
+    Value() : tag_{Type::UNDEFINED, false} { as.object = nullptr; }
+    explicit Value(double number) : tag_{Type::NUMBER, false} { as.number = number; }
+    explicit Value(int64_t integer) : tag_{Type::NUMBER, true} { as.integer = integer; }
+    explicit Value(bool boolean) : tag_{Type::BOOLEAN, false} { as.object = nullptr; as.boolean = boolean; }
+
+    // Takes a reference to a freshly allocated or already shared object
+    Value(Type type, Obj* object) : tag_{type, false} {
+        as.object = object;
+        retain();
+    }
+
+    Value(const Value& other) : tag_(other.tag_), as(other.as) {
+        retain();
+    }
+
+    Value(Value&& other) noexcept : tag_(other.tag_), as(other.as) {
+        other.tag_ = Tag{Type::UNDEFINED, false};
+        other.as.object = nullptr;
+    }
+
+    Value& operator=(const Value& other) {
+        if (!isObject() && !other.isObject()) {
+            // Nothing to retain or release
+            tag_ = other.tag_;
+            as = other.as;
+        } else if (this != &other) {
+            Value copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            tag_ = other.tag_;
+            as = other.as;
+            other.tag_ = Tag{Type::UNDEFINED, false};
+            other.as.object = nullptr;
+        }
+        return *this;
+    }
+
+    ~Value() {
+        release();
+    }
+
+    void swap(Value& other) noexcept {
+        std::swap(tag_, other.tag_);
+        std::swap(as, other.as);
+    }
+
+    Type type() const { return tag_.type; }
+    bool isUndefined() const { return tag_.type == Type::UNDEFINED; }
+    bool isObject() const { return tag_.type >= Type::STRING; }
+    bool isContainer() const { return tag_.type == Type::ARRAY || tag_.type == Type::FUNCTION || tag_.type == Type::MAP; }
+
+    bool isInteger() const { return tag_.integer; }
+
+    double number() const { return tag_.integer ? static_cast<double>(as.integer) : as.number; }
+    int64_t integer() const { return as.integer; }
+    bool boolean() const { return as.boolean; }
+    Obj* object() const { return as.object; }
+
+private:
+    // Kept together so that a copy moves both in one store
+    struct Tag {
+        Type type;
+        bool integer;
+    } tag_;
+    union {
+        double number;
+        int64_t integer;
+        bool boolean;
+        Obj* object;
+    } as;
+
+    void retain() {
+        if (isObject()) {
+            retainObj(as.object);
+        }
+    }
+
+    void release() {
+        if (isObject()) {
+            releaseObj(as.object);
+        }
+    }
+};
+
+inline void Tracer::visit(const Value& value) {
+    if (value.isContainer()) {
+        visit(static_cast<Container*>(value.object()));
+    }
+}
+
+inline void ValueBuffer::trace(Tracer& tracer) {
+    for (const auto& item : items) {
+        tracer.visit(item);
+    }
+}
+
+inline void ValueBuffer::clearReferences() {
+    std::vector<Value> dropped;
+    dropped.swap(items);
+}
+
+inline ObjArray::ObjArray(std::vector<double> values, bool integers)
+    : numbers(new NumberBuffer()), length(values.size()), integers(integers) {
+    numbers->items = std::move(values);
+}
+
+inline ObjArray::ObjArray(std::vector<Value> values) : length(values.size()) {
+    integers = !values.empty() && values[0].isInteger();
+    bool packed = true;
+    for (const auto& value : values) {
+        if (!packable(value)) {
+            packed = false;
+            break;
+        }
+    }
+    if (!packed) {
+        elements = new ValueBuffer();
+        elements->items = std::move(values);
+        return;
+    }
+    numbers = new NumberBuffer();
+    numbers->items.resize(values.size());
+    double* out = numbers->items.data();
+    for (const auto& value : values) {
+        *out++ = value.number();
+    }
+}
+
+inline ObjArray::ObjArray(const ObjArray& left, const ObjArray& right) : length(left.length) {
+    bool sameKind = left.integers == right.integers || left.length == 0 || right.length == 0;
+    if (left.numbers && !(right.numbers && sameKind)) {
+        // Numbers followed by other values: this array starts out generic
+        elements = new ValueBuffer();
+        elements->items.reserve(left.length + right.length);
+        for (size_t i = 0; i < left.length; i++) {
+            elements->items.push_back(left.get(i));
+        }
+    } else {
+        numbers = left.numbers;
+        elements = left.elements;
+        integers = left.length != 0 ? left.integers : right.integers;
+        ownBufferEnd();
+    }
+
+    // Index rather than iterate: 'right' may share the buffer being appended to
+    size_t count = right.length;
+    if (numbers) {
+        std::vector<double>& items = numbers->items;
+        reserveFor(items, count);
+        for (size_t i = 0; i < count; i++) {
+            items.push_back(right.numbers->items[i]);
+        }
+    } else {
+        std::vector<Value>& items = elements->items;
+        reserveFor(items, count);
+        for (size_t i = 0; i < count; i++) {
+            items.push_back(right.get(i));
+        }
+    }
+    length += count;
+}
+
+inline Value ObjArray::get(size_t index) const {
+    if (!numbers) {
+        return elements->items[index];
+    }
+    double number = numbers->items[index];
+    return integers ? Value(static_cast<int64_t>(number)) : Value(number);
+}
+
+// A number of the packed kind; the first number appended to an empty array
+// picks the kind
+inline bool ObjArray::packable(const Value& value) const {
+    if (value.type() != Value::Type::NUMBER) {
+        return false;
+    }
+    if (!value.isInteger()) {
+        return !integers;
+    }
+    return integers && packsExactly(value.integer());
+}
+
+inline void ObjArray::set(size_t index, Value value) {
+    if (numbers) {
+        if (packable(value)) {
+            ownBuffer();
+            numbers->items[index] = value.number();
+            return;
+        }
+        unpack();
+    }
+    ownBuffer();
+    elements->items[index] = std::move(value);
+}
+
+inline void ObjArray::append(Value value) {
+    if (numbers && length == 0) {
+        integers = value.isInteger();
+    }
+    if (numbers && !packable(value)) {
+        unpack();
+    }
+    ownBufferEnd();
+    if (numbers) {
+        numbers->items.push_back(value.number());
+    } else {
+        elements->items.push_back(std::move(value));
+    }
+    length++;
+}
+
+inline Value ObjArray::removeLast() {
+    Value last = get(length - 1);
+    length--;
+
+    // Elements past the end may still be seen by an array sharing the buffer
+    if (numbers && numbers->refCount == 1) {
+        numbers->items.resize(length);
+    } else if (elements && elements->refCount == 1) {
+        elements->items.resize(length, Value());
+    }
+    return last;
+}
+
+inline void ObjArray::resize(size_t size) {
+    ownBuffer();
+    ownBufferEnd();
+    if (numbers) {
+        // The zeros are integers, like the literal 0
+        if (length == 0) {
+            integers = true;
+        }
+        numbers->items.resize(size, 0.0);
+    } else {
+        elements->items.resize(size, Value(int64_t(0)));
+    }
+    length = size;
+}
+
+inline void ObjArray::unpack() {
+    Ref<ValueBuffer> unpacked = new ValueBuffer();
+    unpacked->items.reserve(length);
+    for (size_t i = 0; i < length; i++) {
+        unpacked->items.push_back(get(i));
+    }
+    elements = std::move(unpacked);
+    numbers = nullptr;
+}
+
+// Copy the buffer if another array shares it, before writing an element
+inline void ObjArray::ownBuffer() {
+    if (numbers && numbers->refCount > 1) {
+        Ref<NumberBuffer> copy = new NumberBuffer();
+        copy->items.assign(numbers->items.begin(), numbers->items.begin() + length);
+        numbers = std::move(copy);
+    } else if (elements && elements->refCount > 1) {
+        Ref<ValueBuffer> copy = new ValueBuffer();
+        copy->items.assign(elements->items.begin(), elements->items.begin() + length);
+        elements = std::move(copy);
+    }
+}
+
+// Make sure this array's elements end the buffer, before appending to it.
+// Elements past them belong to another array, unless nothing else uses the
+// buffer any more.
+inline void ObjArray::ownBufferEnd() {
+    if (numbers && numbers->items.size() != length) {
+        if (numbers->refCount > 1) {
+            ownBuffer();
+        } else {
+            numbers->items.resize(length);
+        }
+    } else if (elements && elements->items.size() != length) {
+        if (elements->refCount > 1) {
+            ownBuffer();
+        } else {
+            elements->items.resize(length, Value());
+        }
+    }
+}
+
+inline void ObjArray::trace(Tracer& tracer) {
+    if (elements) {
+        tracer.visit(elements.get());
+    }
+}
+
+inline void ObjArray::clearReferences() {
+    elements = nullptr;
+    numbers = new NumberBuffer();
+    length = 0;
+}
+
+inline Value makeNumber(double val) { return Value(val); }
+inline Value makeInteger(int64_t val) { return Value(val); }
+
+// Whether 'val' is whole and fits in 64 bits. -0 does not count, so that
+// 1 / -0 keeps its sign.
+inline bool holdsInteger(double val) {
+    return val >= -9223372036854775808.0 && val < 9223372036854775808.0 &&
+           static_cast<double>(static_cast<int64_t>(val)) == val && !(val == 0 && std::signbit(val));
+}
+
+// An integer when 'val' holds one, else a double
+inline Value makeNumberOrInteger(double val) {
+    return holdsInteger(val) ? Value(static_cast<int64_t>(val)) : Value(val);
+}
+inline Value makeString(const std::string& val) { return Value(Value::Type::STRING, new ObjString(val)); }
+inline Value makeString(ObjString* shared) { return Value(Value::Type::STRING, shared); }
+inline Value makeString(Ref<ObjString> left, Ref<ObjString> right) {
+    return Value(Value::Type::STRING, new ObjString(std::move(left), std::move(right)));
+}
+inline Value makeBoolean(bool val) { return Value(val); }
+inline Value makeArray(std::vector<Value> val) { return Value(Value::Type::ARRAY, new ObjArray(std::move(val))); }
+inline Value makeArray(std::vector<double> val, bool integers = false) {
+    return Value(Value::Type::ARRAY, new ObjArray(std::move(val), integers));
+}
+
+inline bool isNumber(const Value& val) { return val.type() == Value::Type::NUMBER; }
+inline bool isString(const Value& val) { return val.type() == Value::Type::STRING; }
+inline bool isBoolean(const Value& val) { return val.type() == Value::Type::BOOLEAN; }
+inline bool isArray(const Value& val) { return val.type() == Value::Type::ARRAY; }
+inline bool isFunction(const Value& val) { return val.type() == Value::Type::FUNCTION; }
+
+inline double asNumber(const Value& val) {
+    if (!isNumber(val)) throw std::runtime_error("Value is not a number");
+    return val.number();
+}
+
+// Orders two numbers exactly, even an integer against a double near it:
+// -1, 0 or 1, or 2 when either is NaN
+inline int numberOrder(const Value& a, const Value& b) {
+    if (a.isInteger() && b.isInteger()) {
+        return a.integer() < b.integer() ? -1 : a.integer() > b.integer() ? 1 : 0;
+    }
+    if (!a.isInteger() && !b.isInteger()) {
+        double x = a.number();
+        double y = b.number();
+        return x < y ? -1 : x > y ? 1 : x == y ? 0 : 2;
+    }
+    bool flipped = b.isInteger();
+    int64_t integer = flipped ? b.integer() : a.integer();
+    double number = flipped ? a.number() : b.number();
+    int order;
+    if (std::isnan(number)) {
+        return 2;
+    } else if (number >= 9223372036854775808.0) {
+        order = -1;
+    } else if (number < -9223372036854775808.0) {
+        order = 1;
+    } else {
+        int64_t whole = static_cast<int64_t>(number);
+        double fraction = number - static_cast<double>(whole);
+        order = integer != whole ? (integer < whole ? -1 : 1)
+              : fraction > 0 ? -1 : fraction < 0 ? 1 : 0;
+    }
+    return flipped ? -order : order;
+}
+
+// Equality of two numbers; two doubles take the quick path
+inline bool sameNumber(const Value& a, const Value& b) {
+    if (!a.isInteger() && !b.isInteger()) {
+        return a.number() == b.number();
+    }
+    return numberOrder(a, b) == 0;
+}
+inline const std::string& asString(const Value& val) {
+    if (!isString(val)) throw std::runtime_error("Value is not a string");
+    return static_cast<ObjString*>(val.object())->str();
+}
+inline bool asBoolean(const Value& val) {
+    if (!isBoolean(val)) throw std::runtime_error("Value is not a boolean");
+    return val.boolean();
+}
+inline ObjArray& asArray(const Value& val) {
+    if (!isArray(val)) throw std::runtime_error("Value is not an array");
+    return *static_cast<ObjArray*>(val.object());
+}
+
+#endif // VALUE_H
@@ -14,21 +14,17 @@ class LoopStmt;
 class BreakStmt;
 class ContinueStmt;
 class ExpressionStmt;
-class CompEqStmt;
-class CompNeqStmt;
-class CompGeStmt;
-class CompLeStmt;
+class CompareStmt;
 class AndStmt;
 class OrStmt;
 class NotStmt;
 class CompEqExpr;
-class CompGStmt;
-class CompLStmt;
 class AndConditionStmt;
 class OrConditionStmt;
 class AssignExpr;
 class ArrayExpr;
 class FixedArrayExpr;
+class MapExpr;
 class IndexExpr;
 class AssignIndexExpr;
 class FunctionStmt;
@@ -50,21 +46,17 @@ public:
     virtual void visit(BreakStmt* stmt) = 0;  
     virtual void visit(ContinueStmt* stmt) = 0; 
     virtual void visit(ExpressionStmt* stmt) = 0;
-    virtual void visit(CompEqStmt* stmt) = 0;
-    virtual void visit(CompNeqStmt* stmt) = 0;
-    virtual void visit(CompGeStmt* stmt) = 0;
-    virtual void visit(CompLeStmt* stmt) = 0;
+    virtual void visit(CompareStmt* stmt) = 0;
     virtual void visit(AndStmt* stmt) = 0;
     virtual void visit(OrStmt* stmt) = 0;
     virtual void visit(NotStmt* stmt) = 0;
     virtual void visit(CompEqExpr* expr) = 0;
-    virtual void visit(CompGStmt* stmt) = 0;
-    virtual void visit(CompLStmt* stmt) = 0;
     virtual void visit(AndConditionStmt* stmt) = 0;
     virtual void visit(OrConditionStmt* stmt) = 0;
     virtual void visit(AssignExpr* expr) = 0;
     virtual void visit(ArrayExpr* expr) = 0;
     virtual void visit(FixedArrayExpr* expr) = 0;
+    virtual void visit(MapExpr* expr) = 0;
     virtual void visit(IndexExpr* expr) = 0;
     virtual void visit(AssignIndexExpr* expr) = 0;
     virtual void visit(FunctionStmt* stmt) = 0;
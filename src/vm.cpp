@@ -0,0 +1,470 @@
+// vm.cpp
+
+#include "vm.h"
+#include "gc.h"
+#include "runtime.h"
+#include "builtins.h"
+#include "dispatch.h"
+#include "profiler.h"
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+int VMFunction::arity() const {
+    return proto->arity;
+}
+
+Value VMFunction::call(Interpreter* interpreter, const std::vector<Value>& arguments) {
+    throw std::runtime_error("Compiled functions can only be called by the VM.");
+}
+
+std::string VMFunction::toString() const {
+    return "<function " + proto->name + ">";
+}
+
+void VM::interpret(const std::shared_ptr<FunctionProto>& script) {
+    try {
+        globals->reserve(script->localNames.size());
+        globalNames = script->localNames;
+        frames.push_back(CallFrame{script.get(), script->chunk.code.data(), 0, globals, globals->values().data()});
+        run();
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Runtime error: " << error.what() << std::endl;
+        stack.clear();
+        frames.clear();
+    }
+}
+
+void VM::run() {
+    CallFrame* frame = &frames.back();
+    const uint8_t* ip = frame->ip;
+    const Chunk* chunk = &frame->function->chunk;
+    Value* globalSlots = globals->values().data();
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+#define READ_NAME() (chunk->names[READ_SHORT()])
+
+// Calls and backward jumps are where the profiler takes its samples
+#define SAMPLE_POINT() if (Profiler::pending) { frame->ip = ip; sampleStack(); }
+
+    while (true) {
+        OpCode instruction = static_cast<OpCode>(READ_BYTE());
+        switch (instruction) {
+            case OpCode::CONSTANT:
+                push(chunk->constants[READ_SHORT()]);
+                break;
+
+            case OpCode::POP:
+                stack.pop_back();
+                break;
+
+            case OpCode::DEFINE_GLOBAL:
+                globalSlots[READ_SHORT()] = pop();
+                break;
+
+            case OpCode::GET_GLOBAL: {
+                uint16_t slot = READ_SHORT();
+                if (globalSlots[slot].isUndefined()) {
+                    undefinedVariable(globalNames[slot]);
+                }
+                push(globalSlots[slot]);
+                break;
+            }
+
+            case OpCode::SET_GLOBAL: {
+                uint16_t slot = READ_SHORT();
+                if (globalSlots[slot].isUndefined()) {
+                    undefinedVariable(globalNames[slot]);
+                }
+                globalSlots[slot] = peek();
+                break;
+            }
+
+            case OpCode::DEFINE_LOCAL:
+                frame->slots[READ_SHORT()] = pop();
+                break;
+
+            case OpCode::GET_LOCAL: {
+                uint16_t slot = READ_SHORT();
+                if (frame->slots[slot].isUndefined()) {
+                    undefinedVariable(frame->function->localNames[slot]);
+                }
+                push(frame->slots[slot]);
+                break;
+            }
+
+            case OpCode::SET_LOCAL: {
+                uint16_t slot = READ_SHORT();
+                if (frame->slots[slot].isUndefined()) {
+                    undefinedVariable(frame->function->localNames[slot]);
+                }
+                frame->slots[slot] = peek();
+                break;
+            }
+
+            case OpCode::GET_OUTER: {
+                uint8_t depth = READ_BYTE();
+                uint16_t slot = READ_SHORT();
+                const std::string& name = READ_NAME();
+                push(frame->environment->get(depth, slot, name));
+                break;
+            }
+
+            case OpCode::SET_OUTER: {
+                uint8_t depth = READ_BYTE();
+                uint16_t slot = READ_SHORT();
+                const std::string& name = READ_NAME();
+                frame->environment->assign(depth, slot, name, peek());
+                break;
+            }
+
+            case OpCode::ADD: {
+                Value right = pop();
+                peek() = add(peek(), right);
+                break;
+            }
+
+            case OpCode::SUBTRACT:
+            case OpCode::MULTIPLY:
+            case OpCode::DIVIDE:
+            case OpCode::MODULO: {
+                Value right = pop();
+                peek() = arithmetic(instruction, peek(), right);
+                break;
+            }
+
+            case OpCode::GREATER:
+            case OpCode::GREATER_EQUAL:
+            case OpCode::LESS:
+            case OpCode::LESS_EQUAL: {
+                Value right = pop();
+                peek() = compare(instruction, peek(), right);
+                break;
+            }
+
+            case OpCode::EQUAL: {
+                Value right = pop();
+                peek() = makeBoolean(isEqual(peek(), right));
+                break;
+            }
+
+            case OpCode::NOT_EQUAL: {
+                Value right = pop();
+                peek() = makeBoolean(!isEqual(peek(), right));
+                break;
+            }
+
+            case OpCode::ARRAY: {
+                uint16_t count = READ_SHORT();
+                Value array = buildArray(count);
+                push(array);
+                break;
+            }
+
+            case OpCode::FIXED_ARRAY: {
+                uint16_t size = READ_SHORT();
+                uint16_t count = READ_SHORT();
+                Value array = buildArray(count);
+
+                // Pad with zeros or trim to the declared size
+                asArray(array).resize(size);
+                push(array);
+                break;
+            }
+
+            case OpCode::MAP: {
+                // Keys and values alternate on the stack
+                size_t count = READ_SHORT();
+                Value map = makeMap();
+                ObjMap& entries = asMap(map);
+                for (size_t i = stack.size() - 2 * count; i < stack.size(); i += 2) {
+                    entries.set(stack[i], std::move(stack[i + 1]));
+                }
+                stack.resize(stack.size() - 2 * count);
+                push(std::move(map));
+                break;
+            }
+
+            case OpCode::INDEX: {
+                Value index = pop();
+                peek() = indexValue(peek(), index);
+                break;
+            }
+
+            case OpCode::SET_INDEX: {
+                Value value = pop();
+                Value index = pop();
+                assignIndex(peek(), index, value);
+                peek() = std::move(value);
+                break;
+            }
+
+            case OpCode::JUMP: {
+                uint16_t offset = READ_SHORT();
+                ip += offset;
+                break;
+            }
+
+            case OpCode::JUMP_IF_FALSE: {
+                uint16_t offset = READ_SHORT();
+                if (!isTruthy(pop())) {
+                    ip += offset;
+                }
+                break;
+            }
+
+            case OpCode::JUMP_UNLESS: {
+                Comparison op = static_cast<Comparison>(READ_BYTE());
+                uint16_t offset = READ_SHORT();
+                bool holds = compareValues(op, peek(1), peek(0));
+                stack.resize(stack.size() - 2);
+                if (!holds) {
+                    ip += offset;
+                }
+                break;
+            }
+
+            case OpCode::JUMP_UNLESS_LOCAL:
+            case OpCode::JUMP_UNLESS_GLOBAL: {
+                Comparison op = static_cast<Comparison>(READ_BYTE());
+                uint16_t slot = READ_SHORT();
+                const Value& constant = chunk->constants[READ_SHORT()];
+                uint16_t offset = READ_SHORT();
+
+                const Value& variable = instruction == OpCode::JUMP_UNLESS_LOCAL ? frame->slots[slot] : globalSlots[slot];
+                if (variable.isUndefined()) {
+                    undefinedVariable(instruction == OpCode::JUMP_UNLESS_LOCAL
+                                      ? frame->function->localNames[slot] : globalNames[slot]);
+                }
+                if (!compareValues(op, variable, constant)) {
+                    ip += offset;
+                }
+                break;
+            }
+
+            case OpCode::SWITCH: {
+                const Value& table = chunk->constants[READ_SHORT()];
+                uint16_t offset = READ_SHORT();
+                const Value* target = dispatchEntry(table, peek());
+                if (target != nullptr) {
+                    offset = static_cast<uint16_t>(asNumber(*target));
+                }
+                stack.pop_back();
+                ip += offset;
+                break;
+            }
+
+            case OpCode::LOOP_ENTER: {
+                bool down = READ_BYTE() != 0;
+                LoopVar var = static_cast<LoopVar>(READ_BYTE());
+                uint16_t slot = READ_SHORT();
+                uint16_t offset = READ_SHORT();
+
+                // Same checks, in the same order, as the tree-walking interpreter
+                asNumber(peek(2));
+                asNumber(peek(1));
+                asNumber(peek(0));
+
+                const Value& counter = peek(2);
+                if (var == LoopVar::LOCAL) {
+                    frame->slots[slot] = counter;
+                } else if (var == LoopVar::GLOBAL) {
+                    globalSlots[slot] = counter;
+                }
+                if (loopFinished(down, counter, peek(1))) {
+                    ip += offset;
+                }
+                break;
+            }
+
+            case OpCode::LOOP_NEXT: {
+                bool down = READ_BYTE() != 0;
+                LoopVar var = static_cast<LoopVar>(READ_BYTE());
+                uint16_t slot = READ_SHORT();
+                uint16_t offset = READ_SHORT();
+                SAMPLE_POINT();
+
+                // The operands were checked by LOOP_ENTER and the body cannot
+                // reach them. Integer operands keep an integer counter.
+                Value* operands = &peek(2);
+                operands[0] = down ? subtractNumbers(operands[0], operands[2]) : addNumbers(operands[0], operands[2]);
+
+                if (var == LoopVar::LOCAL) {
+                    frame->slots[slot] = operands[0];
+                } else if (var == LoopVar::GLOBAL) {
+                    globalSlots[slot] = operands[0];
+                }
+                if (!loopFinished(down, operands[0], operands[1])) {
+                    ip -= offset;
+                }
+                break;
+            }
+
+            case OpCode::CLOSURE: {
+                const auto& proto = chunk->functions[READ_SHORT()];
+                push(makeFunction(new VMFunction(proto, frame->environment)));
+                break;
+            }
+
+            case OpCode::CALL: {
+                uint8_t argCount = READ_BYTE();
+                SAMPLE_POINT();
+                size_t calleeSlot = stack.size() - argCount - 1;
+                const Value& callee = stack[calleeSlot];
+
+                if (!isFunction(callee)) {
+                    throw std::runtime_error("Can only call functions.");
+                }
+
+                Callable* function = asFunction(callee);
+                if (argCount != function->arity()) {
+                    throw std::runtime_error(
+                        "Expected " + std::to_string(function->arity()) +
+                        " arguments but got " + std::to_string(argCount) + "."
+                    );
+                }
+
+                if (function->kind == Callable::Kind::NATIVE) {
+                    // Natives read their arguments straight off the stack
+                    Value result = static_cast<NativeFunction*>(function)->invoke(&stack[calleeSlot + 1]);
+                    stack.resize(calleeSlot);
+                    push(std::move(result));
+                    break;
+                }
+                if (function->kind != Callable::Kind::COMPILED) {
+                    throw std::runtime_error("Can only call functions compiled for the VM.");
+                }
+                auto* compiled = static_cast<VMFunction*>(function);
+
+                if (frames.size() >= kMaxFrames) {
+                    throw std::runtime_error("Stack overflow.");
+                }
+
+                Stats::calls++;
+
+                // Calls are where new environments, and so new cycles, appear
+                CycleCollector::maybeCollect();
+
+                // Bind arguments to the parameter slots of a fresh environment
+                const FunctionProto* proto = compiled->proto.get();
+                auto environment = makeRef<Environment>(compiled->closure, proto->localNames.size());
+                Value* slots = environment->values().data();
+                for (size_t i = 0; i < argCount; i++) {
+                    slots[i] = std::move(stack[calleeSlot + 1 + i]);
+                }
+
+                frame->ip = ip;
+                frames.push_back(CallFrame{proto, proto->chunk.code.data(), calleeSlot, environment, slots});
+                frame = &frames.back();
+                ip = frame->ip;
+                chunk = &proto->chunk;
+                break;
+            }
+
+            case OpCode::RETURN_VALUE: {
+                Value result = pop();
+                size_t base = frame->stackBase;
+                frames.pop_back();
+
+                if (frames.empty()) {
+                    stack.clear();
+                    return;
+                }
+
+                stack.resize(base);
+                push(result);
+                frame = &frames.back();
+                ip = frame->ip;
+                chunk = &frame->function->chunk;
+                break;
+            }
+
+            case OpCode::PRINT:
+                std::cout << valueToString(pop());
+                break;
+
+            case OpCode::INPUT:
+                push(readInputValue());
+                break;
+
+            case OpCode::ERROR:
+                throw std::runtime_error(asString(chunk->constants[READ_SHORT()]));
+        }
+    }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_NAME
+#undef SAMPLE_POINT
+}
+
+void VM::undefinedVariable(const std::string& name) {
+    throw std::runtime_error("Undefined variable '" + name + "'");
+}
+
+void VM::sampleStack() {
+    std::vector<Profiler::Frame> stack;
+    stack.reserve(frames.size());
+    for (const CallFrame& frame : frames) {
+        // ip is past the instruction that is running, or past the CALL
+        const Chunk& chunk = frame.function->chunk;
+        size_t offset = static_cast<size_t>(frame.ip - chunk.code.data());
+        stack.push_back(Profiler::Frame{frame.function->name, chunk.lineAt(offset == 0 ? 0 : offset - 1)});
+    }
+    Profiler::sample(stack);
+}
+
+Value VM::add(const Value& left, const Value& right) {
+    if (isString(left) || isString(right)) {
+        // String concatenation - convert both operands to string
+        return concatenate(left, right);
+    } else if (isNumber(left) && isNumber(right)) {
+        return addNumbers(left, right);
+    } else if (isArray(left) && isArray(right)) {
+        // Array concatenation
+        return concatenateArrays(asArray(left), asArray(right));
+    }
+    throw std::runtime_error("Operands must be two numbers, two arrays, or at least one string.");
+}
+
+Value VM::arithmetic(OpCode op, const Value& left, const Value& right) {
+    if (!isNumber(left) || !isNumber(right)) {
+        const char* symbol = op == OpCode::SUBTRACT ? "-"
+                           : op == OpCode::MULTIPLY ? "*"
+                           : op == OpCode::DIVIDE ? "/" : "%";
+        throw std::runtime_error(std::string("Operands must be numbers for operator '") + symbol + "'.");
+    }
+
+    switch (op) {
+        case OpCode::SUBTRACT:
+            return subtractNumbers(left, right);
+        case OpCode::MULTIPLY:
+            return multiplyNumbers(left, right);
+        case OpCode::DIVIDE:
+            if (right.number() == 0) {
+                throw std::runtime_error("Error: Division by zero");
+            }
+            return makeNumber(left.number() / right.number());
+        default:
+            if (right.number() == 0) {
+                throw std::runtime_error("Error: Modulo by zero");
+            }
+            return moduloNumbers(left, right);
+    }
+}
+
+Value VM::compare(OpCode op, const Value& left, const Value& right) {
+    switch (op) {
+        case OpCode::GREATER: return makeBoolean(compareValues(Comparison::GREATER, left, right));
+        case OpCode::GREATER_EQUAL: return makeBoolean(compareValues(Comparison::GREATER_EQUAL, left, right));
+        case OpCode::LESS: return makeBoolean(compareValues(Comparison::LESS, left, right));
+        default: return makeBoolean(compareValues(Comparison::LESS_EQUAL, left, right));
+    }
+}
+
+Value VM::buildArray(size_t count) {
+    std::vector<Value> array(stack.end() - count, stack.end());
+    stack.resize(stack.size() - count);
+    return makeArray(std::move(array));
+}
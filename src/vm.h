@@ -0,0 +1,84 @@
+// vm.h
+#ifndef VM_H
+#define VM_H
+
+#include "chunk.h"
+#include "environment.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// A function compiled to bytecode, closed over the environment it was declared in
+class VMFunction : public Callable {
+public:
+    std::shared_ptr<FunctionProto> proto;
+    Ref<Environment> closure;
+
+    VMFunction(std::shared_ptr<FunctionProto> proto, Ref<Environment> closure)
+        : Callable(Kind::COMPILED), proto(proto), closure(std::move(closure)) {}
+
+    void trace(Tracer& tracer) override {
+        tracer.visit(closure.get());
+    }
+
+    void clearReferences() override {
+        closure = nullptr;
+    }
+
+    int arity() const override;
+    Value call(Interpreter* interpreter, const std::vector<Value>& arguments) override;
+    std::string toString() const override;
+};
+
+// Stack-based virtual machine that executes chunks produced by the Compiler
+class VM {
+public:
+    void interpret(const std::shared_ptr<FunctionProto>& script);
+
+    void defineGlobal(int slot, Value value) {
+        globals->define(slot, std::move(value));
+    }
+
+private:
+    struct CallFrame {
+        const FunctionProto* function;
+        const uint8_t* ip;
+        size_t stackBase;
+        Ref<Environment> environment;
+        Value* slots;  // environment's slots, which never move during a call
+    };
+
+    static const size_t kMaxFrames = 65536;
+
+    std::vector<Value> stack;
+    std::vector<CallFrame> frames;
+    Ref<Environment> globals = makeRef<Environment>();
+    std::vector<std::string> globalNames;
+
+    void run();
+
+    // Records the call stack for the profiler; frames[].ip must be current
+    void sampleStack();
+
+    void push(Value value) {
+        stack.push_back(std::move(value));
+    }
+
+    Value pop() {
+        Value value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    }
+
+    Value& peek(size_t distance = 0) {
+        return stack[stack.size() - 1 - distance];
+    }
+
+    [[noreturn]] void undefinedVariable(const std::string& name);
+    Value add(const Value& left, const Value& right);
+    Value compare(OpCode op, const Value& left, const Value& right);
+    Value arithmetic(OpCode op, const Value& left, const Value& right);
+    Value buildArray(size_t count);
+};
+
+#endif // VM_H
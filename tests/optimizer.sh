@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+# Runs every example on both engines with and without -O and fails if the
+# optimizer changes what a script prints.
+#
+# Usage: tests/optimizer.sh [binary]
+
+set -u
+cd "$(dirname "$0")/.."
+
+binary=${1:-bin/axscript}
+failures=0
+
+while IFS= read -r -d '' script; do
+    for flag in --no-cache --interp; do
+        expected=$("$binary" "$flag" "$script" < /dev/null 2>&1)
+        actual=$("$binary" "$flag" -O "$script" < /dev/null 2>&1)
+        if [ "$expected" != "$actual" ]; then
+            echo "FAIL $script ($flag -O)"
+            diff <(echo "$expected") <(echo "$actual")
+            failures=$((failures + 1))
+        fi
+    done
+done < <(find examples bench -name '*.axp' -print0 | sort -z)
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures failing runs"
+    exit 1
+fi
+echo "optimizer output matches"
@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+# Runs every tests/*.axp on both engines with and without -O and fails if
+# what it prints differs from the matching tests/*.out.
+#
+# Usage: tests/outputs.sh [binary]
+
+set -u
+cd "$(dirname "$0")/.."
+
+binary=${1:-bin/axscript}
+failures=0
+
+for script in tests/*.axp; do
+    expected="${script%.axp}.out"
+    for flags in --no-cache "--no-cache -O" --interp "--interp -O"; do
+        # shellcheck disable=SC2086
+        if ! diff <("$binary" $flags "$script" < /dev/null 2>&1) "$expected" > /dev/null; then
+            echo "FAIL $script ($flags)"
+            diff <("$binary" $flags "$script" < /dev/null 2>&1) "$expected"
+            failures=$((failures + 1))
+        fi
+    done
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures failing runs"
+    exit 1
+fi
+echo "test output matches"